@@ -1,8 +1,17 @@
 #include "ldisplay.h"       // For the display helper functions
 #include "lgas.h"           // For gas measurements from the U12
+#include "lexpr.h"          // For the flow and ratio definitions
 #include <unistd.h>
 
 
+// The totals and ratios are the same definitions the monitor publishes by
+// default (see default_exprs in monitor.c), in volume and mass
+const char* gas_exprs[] = {
+    "total_scfh = o2_scfh + fg_scfh",
+    "total_gps = o2_gps + fg_gps",
+    "ratio_scfh = fg_scfh / o2_scfh",
+    "ratio_gps = fg_gps / o2_gps"};
+#define NGASEXPR (sizeof(gas_exprs)/sizeof(char*))
 
 
 int main(void){
@@ -12,6 +21,24 @@ int main(void){
     double fg_scfh, fg_gps;
     double total_scfh, total_gps;
     double ratio_scfh, ratio_gps;
+    LEXPR gasexpr;
+    unsigned int ii;
+
+    lexpr_init(&gasexpr, 1);
+    lexpr_scalar(&gasexpr, "o2_scfh", &o2_scfh);
+    lexpr_scalar(&gasexpr, "o2_gps", &o2_gps);
+    lexpr_scalar(&gasexpr, "fg_scfh", &fg_scfh);
+    lexpr_scalar(&gasexpr, "fg_gps", &fg_gps);
+    lexpr_scalar(&gasexpr, "total_scfh", &total_scfh);
+    lexpr_scalar(&gasexpr, "total_gps", &total_gps);
+    lexpr_scalar(&gasexpr, "ratio_scfh", &ratio_scfh);
+    lexpr_scalar(&gasexpr, "ratio_gps", &ratio_gps);
+    for(ii=0; ii<NGASEXPR; ii++)
+        lexpr_derived(&gasexpr, gas_exprs[ii]);
+    if(lexpr_compile(&gasexpr)){
+        printf("Flow definitions failed to compile.\n");
+        return -1;
+    }
 
 	if(zero_gas()){
 		printf("Zeroing failed.\n");
@@ -29,17 +56,9 @@ int main(void){
         o2_gps = convert_to_mass(o2_scfh, LGAS_O2_MW);
         fg_gps = convert_to_mass(fg_scfh, LGAS_FG_MW);
         // Update the flow and ratio calculations
-        total_scfh = o2_scfh + fg_scfh;
-        total_gps = o2_gps + fg_gps;
-
-        ratio_scfh = -1;
-        ratio_gps = -1;
-        // Only calculate the ratio if the oxygen flow rate is nonzero
-        if(o2_scfh>0.){
-            ratio_scfh = fg_scfh / o2_scfh;
-            ratio_gps = fg_gps / o2_gps;
-        }
-        
+        // The ratios are not finite while the oxygen flow is zero
+        lexpr_eval(&gasexpr);
+
         // Update the output
         clear_terminal();
 
@@ -51,5 +70,6 @@ int main(void){
     }
 
     finish_keypress();
+    lexpr_free(&gasexpr);
     return 0;
 }
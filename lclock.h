@@ -0,0 +1,278 @@
+/*
+.
+.   Tools for mapping a device's sample clock to host time
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LCLOCK gives every sample a device clock index (the number of samples
+.   streamed before it, across every stream of the run) and maps that index
+.   to the host's CLOCK_MONOTONIC.  Within a stream, sample j was taken at
+.
+.       base + j * period
+.
+.   The period is the least-squares slope of the host time at which each
+.   read returned against the index of its last sample.  It is pooled over
+.   the current stream and, with exponential forgetting, over earlier ones,
+.   and it is kept within LCLOCK_MAX_DRIFT of the nominal rate.  The fit
+.   needs a stream that runs for many reads; lclock_start() belongs where
+.   the device stream is (re)started, not before every read.  Until the
+.   second read of the first stream, the period is nominal.
+.
+.   A read can only return after its last sample was taken, so the offset
+.   follows the lower envelope of the reads: the fitted line is moved down
+.   by the smallest residual so far.  Over a long stream this approaches
+.   the fastest read, but that read's own transfer delay cannot be seen
+.   from the host, so every sample time is late by that fixed amount
+.   (typically well under a millisecond over USB or Ethernet).  The first
+.   sample cannot come before the stream was started, so base is never
+.   earlier than the start stamp.  The startup delay (base - start) is
+.   reported as a check on the fit.
+.
+.   Host times convert to CLOCK_REALTIME with lclock_wall() for aligning
+.   data from different devices and hosts in post-processing.
+.
+*/
+
+
+#ifndef __LCLOCK
+#define __LCLOCK
+
+
+// Add some headers
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LCLOCK_VERSION
+Date
+Notes
+
+**1.0
+Original version.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LCLOCK_VERSION 1.0
+
+#define LCLOCK_MAX_DRIFT    1e-3    // Largest fitted rate error (fraction)
+#define LCLOCK_FORGET       0.9     // Weight of earlier streams in the fit
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    double rate;            // Nominal sample rate (Hz)
+    double period;          // Fitted sample period (s)
+    unsigned long long index;   // Device clock index of the next sample
+    unsigned long long first;   // Index of the current stream's first sample
+    double start;           // Host time the current stream was started (s)
+    double base;            // Host time of the current stream's first sample
+    // Fit of read times within the current stream, relative to its first read
+    unsigned long n;
+    double k0, t0;
+    double sx, sy, sxx, sxy;
+    double minres;          // Smallest residual (s)
+    // Pooled centered sums from earlier streams
+    double pxx, pxy;
+    // Diagnostics
+    unsigned long streams, reads;
+    double latency;         // Last read's delay after its last sample (s)
+    double maxlatency;
+    double startup;         // Current stream's delay to the first sample (s)
+    double wall;            // CLOCK_REALTIME - CLOCK_MONOTONIC at the last read
+} LCLOCK;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LCLOCK_INIT
+.   Initialize a model with no streams.
+*/
+void lclock_init(LCLOCK* clk);
+
+/* LCLOCK_NOW
+.   Return the host CLOCK_MONOTONIC time in seconds.
+*/
+double lclock_now(void);
+
+/* LCLOCK_START
+.   Begin a new stream at rate Hz.  host is the monotonic time just before
+.   the stream was started.  A change of rate discards the fit.
+*/
+void lclock_start(LCLOCK* clk, const double rate, const double host);
+
+/* LCLOCK_READ
+.   Record a read of samples that returned at host time host and update the
+.   fit.  The block's samples are index - samples to index - 1.
+*/
+void lclock_read(LCLOCK* clk, const unsigned int samples, const double host);
+
+/* LCLOCK_HOST
+.   Return the monotonic host time at which a sample of the current stream
+.   was taken.  The index may be fractional (e.g. the middle of a block).
+*/
+double lclock_host(const LCLOCK* clk, const double index);
+
+/* LCLOCK_BACKLOG
+.   Return the number of samples the device has taken by host time host
+.   that have not been read yet.
+*/
+double lclock_backlog(const LCLOCK* clk, const double host);
+
+/* LCLOCK_WALL
+.   Convert a monotonic host time to CLOCK_REALTIME using the offset
+.   measured at the last read.
+*/
+double lclock_wall(const LCLOCK* clk, const double host);
+
+/* LCLOCK_DRIFT
+.   Return the fitted rate error in parts per million; positive when the
+.   device samples slower than nominal.
+*/
+double lclock_drift(const LCLOCK* clk);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+void lclock_init(LCLOCK* clk){
+    memset(clk, 0, sizeof(LCLOCK));
+    clk->base = clk->start = NAN;
+}
+
+//******************************************************************************
+double lclock_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+//******************************************************************************
+void lclock_start(LCLOCK* clk, const double rate, const double host){
+    if(rate != clk->rate){
+        clk->rate = rate;
+        clk->period = rate > 0. ? 1./rate : 0.;
+        clk->pxx = clk->pxy = 0.;
+    }else if(clk->n > 1){
+        // Only the slope of the last stream carries over
+        clk->pxx = LCLOCK_FORGET * clk->pxx +
+                clk->sxx - clk->sx * clk->sx / clk->n;
+        clk->pxy = LCLOCK_FORGET * clk->pxy +
+                clk->sxy - clk->sx * clk->sy / clk->n;
+    }
+    clk->first = clk->index;
+    clk->start = host;
+    clk->base = host;
+    clk->n = 0;
+    clk->sx = clk->sy = clk->sxx = clk->sxy = 0.;
+    clk->streams++;
+}
+
+//******************************************************************************
+void lclock_read(LCLOCK* clk, const unsigned int samples, const double host){
+    struct timespec real, mono;
+    double k, x, y, sxx, sxy, period, intercept, nominal;
+
+    clk->index += samples;
+    clk->reads++;
+    // Samples in this stream so far; the last one is k - 1
+    k = clk->index - clk->first;
+    if(clk->n == 0){
+        clk->k0 = k;
+        clk->t0 = host;
+        clk->minres = INFINITY;
+    }
+    x = k - clk->k0;
+    y = host - clk->t0;
+    clk->n++;
+    clk->sx += x;
+    clk->sy += y;
+    clk->sxx += x*x;
+    clk->sxy += x*y;
+
+    // Pooled slope, kept near the nominal period
+    sxx = clk->pxx + clk->sxx - clk->sx * clk->sx / clk->n;
+    sxy = clk->pxy + clk->sxy - clk->sx * clk->sy / clk->n;
+    nominal = clk->rate > 0. ? 1./clk->rate : 0.;
+    period = sxx > 0. ? sxy / sxx : clk->period;
+    if(period > nominal * (1. + LCLOCK_MAX_DRIFT))
+        period = nominal * (1. + LCLOCK_MAX_DRIFT);
+    else if(period < nominal * (1. - LCLOCK_MAX_DRIFT))
+        period = nominal * (1. - LCLOCK_MAX_DRIFT);
+    clk->period = period;
+
+    // Move the line down to the fastest read
+    intercept = (clk->sy - period * clk->sx) / clk->n;
+    if(y - (intercept + period * x) < clk->minres)
+        clk->minres = y - (intercept + period * x);
+    // The read that completes sample j arrives at x = j + 1 - k0
+    clk->base = clk->t0 + intercept + period * (1. - clk->k0) + clk->minres;
+    if(clk->base < clk->start)
+        clk->base = clk->start;
+
+    clk->startup = clk->base - clk->start;
+    clk->latency = host - lclock_host(clk, clk->index - 1);
+    if(clk->latency > clk->maxlatency)
+        clk->maxlatency = clk->latency;
+
+    clock_gettime(CLOCK_REALTIME, &real);
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clk->wall = (real.tv_sec - mono.tv_sec) +
+            1e-9*(real.tv_nsec - mono.tv_nsec);
+}
+
+//******************************************************************************
+double lclock_host(const LCLOCK* clk, const double index){
+    return clk->base + (index - clk->first) * clk->period;
+}
+
+//******************************************************************************
+double lclock_backlog(const LCLOCK* clk, const double host){
+    double next;
+    next = lclock_host(clk, clk->index);
+    if(!(host >= next) || clk->period <= 0.)
+        return 0.;
+    return floor((host - next) / clk->period) + 1.;
+}
+
+//******************************************************************************
+double lclock_wall(const LCLOCK* clk, const double host){
+    return host + clk->wall;
+}
+
+//******************************************************************************
+double lclock_drift(const LCLOCK* clk){
+    return clk->rate > 0. ? 1e6 * (clk->period * clk->rate - 1.) : 0.;
+}
+
+#endif
@@ -22,6 +22,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 //#include <time.h>
 #include <termios.h>
 #include <sys/select.h>
@@ -39,6 +40,13 @@ Notes
 6/30/2016
 Original version.  Includes print_param(), print_str(), print_int(), and 
 print_flt().
+
+**1.1
+Added poll_prompt(), a prompt that does not block the calling loop.
+
+**1.2
+Added print_spark() and print_trend() for drawing recent history (see
+lhist.h).
 */
 
 
@@ -50,7 +58,7 @@ print_flt().
  *                          *
  ****************************/
 
-#define LDISP_VERSION 1.0
+#define LDISP_VERSION 1.2
 
 /*
 .   Macros for moving the cursor around
@@ -76,6 +84,17 @@ print_flt().
 #define LDISP_FMT_BINT      "\x1B[%d;%dH\x1B[1m%-" LDISP_VALUE_LEN "d\x1B[0m"
 #define LDISP_FMT_BFLT      "\x1B[%d;%dH\x1B[1m%-" LDISP_VALUE_LEN "." LDISP_FLT_PREC "f\x1B[0m"
 
+#define LDISP_FMT_TRND      "\x1B[%d;%dH%s %-+" LDISP_VALUE_LEN ".3g"
+
+// Sparkline characters from lowest to highest (UTF-8)
+#define LDISP_SPARK_CHARS   {"\u2581", "\u2582", "\u2583", "\u2584", \
+                            "\u2585", "\u2586", "\u2587", "\u2588"}
+#define LDISP_SPARK_LEVELS  8
+// Trend arrows: rising, steady, and falling (UTF-8)
+#define LDISP_TREND_UP      "\u2197"
+#define LDISP_TREND_FLAT    "\u2192"
+#define LDISP_TREND_DOWN    "\u2198"
+
 #define LDISP_STDIN_FD      STDIN_FILENO
 
 // Return the maximum integer
@@ -182,6 +201,31 @@ void print_bflt(const unsigned int row,
                 const double value);
 
 
+/* PRINT SPARK
+.   Draw n values as a sparkline n characters wide starting at a row,column
+.   location.  Each value is drawn as one of LDISP_SPARK_LEVELS block heights
+.   scaled between the smallest and largest finite values; NaN values are
+.   left blank.  The values are usually bucket means from lhist_series().
+*/
+void print_spark(const unsigned int row,
+                const unsigned int column,
+                const double* values,
+                const unsigned int n);
+
+/* PRINT TREND
+.   Print an arrow and the rate of change per minute of n values spaced
+.   period seconds apart.  The rate is the least-squares slope of the finite
+.   values.  The arrow is level unless the fitted change over the n values
+.   is more than a quarter of their range, so noise alone reads as steady.
+.   If there are fewer than two finite values, the space is cleared.
+*/
+void print_trend(const unsigned int row,
+                const unsigned int column,
+                const double* values,
+                const unsigned int n,
+                const double period);
+
+
 /* KEYPRESS
 .   Detect whether there is new data waiting on the stdin stream.  This services
 .   a non-blocking keyboard input.  Returns 1 if there is new input.  Returns
@@ -227,6 +271,25 @@ void finish_keypress(void);
 */
 int prompt_on_keypress(int look_for, const char* prompt, char* input, unsigned int length);
 
+/* POLL_PROMPT
+.   A prompt like PROMPT_ON_KEYPRESS that never waits for the user.  Each
+.   call only reads the characters that have already been typed, so the
+.   calling loop keeps running while a line is entered.  When look_for is
+.   pressed (or any key if look_for < 0), the prompt is printed and the
+.   following characters are echoed and collected in input until enter.
+.   Backspace erases the last character.
+.
+.   count holds the state between calls.  It must be initialized to -1,
+.   which means that the prompt is closed; otherwise it is the number of
+.   characters collected so far.  The caller should not draw over the
+.   prompt while count >= 0.
+.
+.   Returns 1 when a line has been entered (input is then terminated and
+.   count is -1 again) and 0 otherwise.
+*/
+int poll_prompt(int look_for, const char* prompt, char* input,
+                const unsigned int length, int* count);
+
 
 /****************************
  *                          *
@@ -335,6 +398,76 @@ void print_bflt(const unsigned int row,
     printf(LDISP_FMT_BFLT,row,column+2,value);
 }
 
+//******************************************************************************
+void print_spark(const unsigned int row,
+                const unsigned int column,
+                const double* values,
+                const unsigned int n){
+    static const char* chars[LDISP_SPARK_LEVELS] = LDISP_SPARK_CHARS;
+    double lo = NAN, hi = NAN;
+    unsigned int ii;
+    int level;
+
+    for(ii=0; ii<n; ii++)
+        if(isfinite(values[ii])){
+            if(!(values[ii] >= lo))
+                lo = values[ii];
+            if(!(values[ii] <= hi))
+                hi = values[ii];
+        }
+    LDISP_CGO(row,column);
+    for(ii=0; ii<n; ii++){
+        if(!isfinite(values[ii]))
+            fputc(' ', stdout);
+        else{
+            // A flat line is drawn at half height
+            level = hi > lo ? (int)((values[ii] - lo) / (hi - lo) *
+                    LDISP_SPARK_LEVELS) : LDISP_SPARK_LEVELS/2 - 1;
+            level = LDISP_CLAMP(level, 0, LDISP_SPARK_LEVELS-1);
+            fputs(chars[level], stdout);
+        }
+    }
+}
+
+//******************************************************************************
+void print_trend(const unsigned int row,
+                const unsigned int column,
+                const double* values,
+                const unsigned int n,
+                const double period){
+    double sx = 0., sy = 0., sxx = 0., sxy = 0., lo = NAN, hi = NAN;
+    double slope, change;
+    const char* arrow;
+    unsigned int ii, count = 0;
+
+    for(ii=0; ii<n; ii++)
+        if(isfinite(values[ii])){
+            sx += ii;
+            sy += values[ii];
+            sxx += (double)ii * ii;
+            sxy += ii * values[ii];
+            if(!(values[ii] >= lo))
+                lo = values[ii];
+            if(!(values[ii] <= hi))
+                hi = values[ii];
+            count++;
+        }
+    if(count < 2 || count * sxx == sx * sx){
+        printf(LDISP_FMT_STR, row, column, "");
+        return;
+    }
+    // Slope per value, then the change over the whole window
+    slope = (count * sxy - sx * sy) / (count * sxx - sx * sx);
+    change = slope * (n - 1);
+    if(change > 0.25 * (hi - lo))
+        arrow = LDISP_TREND_UP;
+    else if(change < -0.25 * (hi - lo))
+        arrow = LDISP_TREND_DOWN;
+    else
+        arrow = LDISP_TREND_FLAT;
+    printf(LDISP_FMT_TRND, row, column, arrow, slope * 60. / period);
+}
+
 //******************************************************************************
 char keypress(void){
 // Credit for this code goes to
@@ -383,4 +516,43 @@ int prompt_on_keypress(int look_for, const char* prompt, char* input, const unsi
     return 0;
 }
 
+//******************************************************************************
+int poll_prompt(int look_for, const char* prompt, char* input,
+                const unsigned int length, int* count){
+    char c;
+    // Read the descriptor directly; characters buffered by stdio would
+    // not be seen by keypress()
+    while(keypress()){
+        if(read(LDISP_STDIN_FD, &c, 1) != 1)
+            return 0;
+        // Open the prompt?
+        if(*count < 0){
+            if(c==look_for || look_for<0){
+                fputs(prompt,stdout);
+                fflush(stdout);
+                *count = 0;
+            }
+            continue;
+        }
+        // Echo and collect the line; the terminal echo is off
+        if(c == '\n' || c == '\r'){
+            input[*count] = '\0';
+            *count = -1;
+            putchar('\n');
+            fflush(stdout);
+            return 1;
+        }else if(c == 127 || c == '\b'){
+            if(*count > 0){
+                (*count)--;
+                fputs("\b \b",stdout);
+            }
+        }else if(*count < (int)length-1){
+            input[(*count)++] = c;
+            putchar(c);
+        }
+        fflush(stdout);
+    }
+    return 0;
+}
+
 #endif
@@ -0,0 +1,883 @@
+/*
+.
+.   Tools for derived channels and alarms defined by expressions
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LEXPR compiles text definitions like
+.
+.       ratio = fuel_scfh / oxygen_scfh
+.       dT = ch2 - ch3
+.
+.   and alarm conditions like
+.
+.       ratio > 2.1
+.
+.   into small stack programs.  Names may refer to scalar values owned by the
+.   host (bound by pointer), to analog input channels, or to other derived
+.   channels in any order; the definitions are sorted so that every channel
+.   is computed after the channels it depends on.
+.
+.   Programs are evaluated a whole block at a time.  Each instruction is a
+.   single tight loop over the block, so the interpreter's cost is paid per
+.   instruction per block rather than per sample.  Scalars are broadcast
+.   against channel blocks.  A definition is only re-evaluated when one of
+.   the inputs it depends on (directly or through other derived channels)
+.   has changed.
+.
+.   The grammar, from lowest to highest precedence, is
+.
+.       compare     sum [ (< | > | <= | >=) sum ]       1 where true, else 0
+.       sum         term { (+ | -) term }
+.       term        unary { (* | /) unary }
+.       unary       - unary | power
+.       power       primary [ ^ unary ]
+.       primary     number | name | function(args) | ( compare )
+.
+.   The functions are abs, sqrt, exp, log, min(a,b), and max(a,b).
+.
+*/
+
+
+#ifndef __LEXPR
+#define __LEXPR
+
+
+// Add some headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LEXPR_VERSION
+Date
+Notes
+
+**1.0
+Original version.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LEXPR_VERSION 1.0
+
+#define LEXPR_MAX_STR       32      // Longest name
+#define LEXPR_MAX_TEXT      128     // Longest definition
+#define LEXPR_MAX_VAR       64      // Names, including inputs
+#define LEXPR_MAX_EQ        32      // Derived channels and alarms
+#define LEXPR_MAX_PROG      64      // Instructions per definition
+#define LEXPR_MAX_STACK     16      // Evaluation stack depth
+
+// Variable kinds
+#define LEXPR_UNKNOWN       0       // Referenced but not yet defined
+#define LEXPR_SCALAR        1       // Host value bound by pointer
+#define LEXPR_CHANNEL       2       // Analog input channel
+#define LEXPR_DERIVED       3       // Defined by an expression
+
+// Instructions
+#define LEXPR_OP_CONST      0
+#define LEXPR_OP_VAR        1
+#define LEXPR_OP_NEG        2
+#define LEXPR_OP_ADD        3
+#define LEXPR_OP_SUB        4
+#define LEXPR_OP_MUL        5
+#define LEXPR_OP_DIV        6
+#define LEXPR_OP_POW        7
+#define LEXPR_OP_LT         8
+#define LEXPR_OP_GT         9
+#define LEXPR_OP_LE         10
+#define LEXPR_OP_GE         11
+#define LEXPR_OP_ABS        12
+#define LEXPR_OP_SQRT       13
+#define LEXPR_OP_EXP        14
+#define LEXPR_OP_LOG        15
+#define LEXPR_OP_MIN        16
+#define LEXPR_OP_MAX        17
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    char name[LEXPR_MAX_STR];
+    int kind;               // LEXPR_UNKNOWN, SCALAR, CHANNEL, or DERIVED
+    double* bind;           // Host value; input for SCALAR, output for DERIVED
+    double last;            // Value of *bind at the last evaluation
+    unsigned int column;    // Channel column in each sample
+    double slope, zero;     // Channel calibration
+    char used;              // Is the channel referenced?
+    int eq;                 // Defining equation for DERIVED
+    double* data;           // Current value(s)
+    unsigned int n;         // Number of values in data; 1 for scalars
+    double value;           // Scalar summary (the block mean)
+} LEXPR_VAR;
+
+typedef struct {
+    int op;
+    unsigned int arg;       // Variable index for LEXPR_OP_VAR
+    double value;           // Constant for LEXPR_OP_CONST
+} LEXPR_INST;
+
+typedef struct {
+    char text[LEXPR_MAX_TEXT];  // Source text
+    int out;                    // Variable defined, or -1 for an alarm
+    LEXPR_INST prog[LEXPR_MAX_PROG];
+    unsigned int nprog;
+    uint64_t deps;              // Input variables this depends on
+    char fresh;                 // Has this been evaluated?
+    // Alarm state
+    char active;                // Was the condition true in the last block?
+    char changed;               // Did active change in the last evaluation?
+    unsigned long count;        // Samples in alarm in the last block
+    unsigned long events;       // Number of times the alarm became active
+} LEXPR_EQ;
+
+typedef struct {
+    LEXPR_VAR var[LEXPR_MAX_VAR];
+    unsigned int nvar;
+    LEXPR_EQ eq[LEXPR_MAX_EQ];
+    unsigned int neq;
+    unsigned int order[LEXPR_MAX_EQ];   // Evaluation order
+    unsigned int maxblock;              // Largest block in samples
+    double* buffer;                     // Channel, derived, and stack storage
+    uint64_t dirty;                     // Inputs changed since the last pass
+    char compiled;
+} LEXPR;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LEXPR_INIT
+.   Initialize an empty set of definitions.  maxblock is the largest number
+.   of samples that will be passed to LEXPR_BLOCK.
+*/
+void lexpr_init(LEXPR* ex, const unsigned int maxblock);
+
+/* LEXPR_SCALAR
+.   Bind a host value to a name.  Expressions read *value as an input.  If
+.   the name is also defined by an expression, the result (its block mean)
+.   is written to *value instead.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lexpr_scalar(LEXPR* ex, const char* name, double* value);
+
+/* LEXPR_CHANNEL
+.   Name an analog input channel.  column is the channel's position in each
+.   interleaved sample; its values are calibrated by slope * (raw - zero).
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lexpr_channel(LEXPR* ex, const char* name, const unsigned int column,
+                const double slope, const double zero);
+
+/* LEXPR_DERIVED
+.   Add a definition of the form "name = expression".
+.
+.   Returns 0 on success and 1 on a syntax error.
+*/
+int lexpr_derived(LEXPR* ex, const char* text);
+
+/* LEXPR_ALARM
+.   Add an alarm condition.  The alarm is active while the expression is
+.   nonzero for any sample in the block.
+.
+.   Returns 0 on success and 1 on a syntax error.
+*/
+int lexpr_alarm(LEXPR* ex, const char* text);
+
+/* LEXPR_COMPILE
+.   Resolve the names, sort the definitions into dependency order, and
+.   allocate the evaluation buffers.  Call this after all of the names and
+.   definitions have been added.
+.
+.   Returns 0 on success and 1 on an undefined name or a circular
+.   definition.
+*/
+int lexpr_compile(LEXPR* ex);
+
+/* LEXPR_BLOCK
+.   Load a new block of interleaved samples.  Only the channels referenced
+.   by some expression are calibrated and copied.  At most maxblock samples
+.   are used.
+*/
+void lexpr_block(LEXPR* ex, const double* data, const unsigned int channels,
+                const unsigned int samples);
+
+/* LEXPR_EVAL
+.   Evaluate every definition whose inputs have changed since the last call
+.   and update the alarms.
+*/
+void lexpr_eval(LEXPR* ex);
+
+/* LEXPR_FIND
+.   Return the index of a variable by name or -1 if it does not exist.
+*/
+int lexpr_find(LEXPR* ex, const char* name);
+
+/* LEXPR_FREE
+.   Release the evaluation buffers.
+*/
+void lexpr_free(LEXPR* ex);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+void lexpr_init(LEXPR* ex, const unsigned int maxblock){
+    memset(ex, 0, sizeof(LEXPR));
+    ex->maxblock = maxblock ? maxblock : 1;
+}
+
+//******************************************************************************
+int lexpr_find(LEXPR* ex, const char* name){
+    unsigned int ii;
+    for(ii=0; ii<ex->nvar; ii++)
+        if(strcmp(ex->var[ii].name, name)==0)
+            return ii;
+    return -1;
+}
+
+//******************************************************************************
+// Find a variable or add it as LEXPR_UNKNOWN
+static int lexpr_lookup(LEXPR* ex, const char* name){
+    int index;
+    index = lexpr_find(ex, name);
+    if(index >= 0)
+        return index;
+    if(ex->nvar >= LEXPR_MAX_VAR){
+        printf("LEXPR: Too many names; %s is not allowed\n", name);
+        return -1;
+    }
+    index = ex->nvar++;
+    memset(&ex->var[index], 0, sizeof(LEXPR_VAR));
+    strcpy(ex->var[index].name, name);
+    ex->var[index].eq = -1;
+    ex->var[index].n = 1;
+    ex->var[index].data = &ex->var[index].value;
+    return index;
+}
+
+//******************************************************************************
+static int lexpr_valid_name(const char* name){
+    if(strlen(name) == 0 || strlen(name) >= LEXPR_MAX_STR ||
+            !(isalpha((unsigned char)name[0]) || name[0]=='_'))
+        return 0;
+    for(; *name; name++)
+        if(!(isalnum((unsigned char)*name) || *name=='_'))
+            return 0;
+    return 1;
+}
+
+//******************************************************************************
+int lexpr_scalar(LEXPR* ex, const char* name, double* value){
+    int index;
+    if(!lexpr_valid_name(name) || (index = lexpr_lookup(ex, name)) < 0)
+        return 1;
+    // A name that is already defined keeps its definition and only gains
+    // somewhere to write the result
+    if(ex->var[index].kind != LEXPR_DERIVED)
+        ex->var[index].kind = LEXPR_SCALAR;
+    ex->var[index].bind = value;
+    return 0;
+}
+
+//******************************************************************************
+int lexpr_channel(LEXPR* ex, const char* name, const unsigned int column,
+                const double slope, const double zero){
+    int index;
+    if(!lexpr_valid_name(name) || (index = lexpr_lookup(ex, name)) < 0)
+        return 1;
+    ex->var[index].kind = LEXPR_CHANNEL;
+    ex->var[index].column = column;
+    ex->var[index].slope = slope;
+    ex->var[index].zero = zero;
+    return 0;
+}
+
+
+/*
+.   Parser
+.
+.   A recursive descent parser emits instructions for a stack machine in
+.   postfix order while tracking the stack depth.
+*/
+
+typedef struct {
+    LEXPR* ex;
+    LEXPR_EQ* eq;
+    const char* ptr;
+    unsigned int depth;
+    int err;
+} LEXPR_PARSER;
+
+static void lexpr_parse_compare(LEXPR_PARSER* p);
+
+static void lexpr_skip(LEXPR_PARSER* p){
+    while(isspace((unsigned char)*p->ptr))
+        p->ptr++;
+}
+
+static void lexpr_error(LEXPR_PARSER* p, const char* message){
+    if(!p->err)
+        printf("LEXPR: %s at \"%s\" in \"%s\"\n", message, p->ptr, p->eq->text);
+    p->err = 1;
+}
+
+// Append an instruction; delta is its net effect on the stack depth
+static void lexpr_emit(LEXPR_PARSER* p, const int op, const unsigned int arg,
+                const double value, const int delta){
+    LEXPR_INST* inst;
+    if(p->err)
+        return;
+    if(p->eq->nprog >= LEXPR_MAX_PROG){
+        lexpr_error(p, "Expression is too long");
+        return;
+    }
+    p->depth += delta;
+    if(p->depth > LEXPR_MAX_STACK){
+        lexpr_error(p, "Expression is nested too deeply");
+        return;
+    }
+    inst = &p->eq->prog[p->eq->nprog++];
+    inst->op = op;
+    inst->arg = arg;
+    inst->value = value;
+}
+
+static void lexpr_parse_primary(LEXPR_PARSER* p){
+    static const char* funcs[] = {"abs", "sqrt", "exp", "log", "min", "max"};
+    static const int ops[] = {LEXPR_OP_ABS, LEXPR_OP_SQRT, LEXPR_OP_EXP, LEXPR_OP_LOG,
+            LEXPR_OP_MIN, LEXPR_OP_MAX};
+    char name[LEXPR_MAX_STR];
+    unsigned int ii, length;
+    int index;
+    char* end;
+    double value;
+
+    lexpr_skip(p);
+    if(*p->ptr == '('){
+        p->ptr++;
+        lexpr_parse_compare(p);
+        lexpr_skip(p);
+        if(*p->ptr != ')')
+            lexpr_error(p, "Expected )");
+        else
+            p->ptr++;
+        return;
+    }else if(isdigit((unsigned char)*p->ptr) || *p->ptr == '.'){
+        value = strtod(p->ptr, &end);
+        if(end == p->ptr){
+            lexpr_error(p, "Bad number");
+            return;
+        }
+        p->ptr = end;
+        lexpr_emit(p, LEXPR_OP_CONST, 0, value, 1);
+        return;
+    }else if(!(isalpha((unsigned char)*p->ptr) || *p->ptr == '_')){
+        lexpr_error(p, "Expected a number, name, or (");
+        return;
+    }
+
+    // Read a name
+    for(length=0; isalnum((unsigned char)p->ptr[length]) || p->ptr[length]=='_';
+            length++);
+    if(length >= LEXPR_MAX_STR){
+        lexpr_error(p, "Name is too long");
+        return;
+    }
+    memcpy(name, p->ptr, length);
+    name[length] = '\0';
+    p->ptr += length;
+    lexpr_skip(p);
+
+    // Function call?
+    if(*p->ptr == '('){
+        for(ii=0; ii<sizeof(ops)/sizeof(int); ii++)
+            if(strcmp(name, funcs[ii])==0)
+                break;
+        if(ii == sizeof(ops)/sizeof(int)){
+            lexpr_error(p, "Unknown function");
+            return;
+        }
+        p->ptr++;
+        lexpr_parse_compare(p);
+        if(ops[ii] == LEXPR_OP_MIN || ops[ii] == LEXPR_OP_MAX){
+            lexpr_skip(p);
+            if(*p->ptr != ','){
+                lexpr_error(p, "Expected ,");
+                return;
+            }
+            p->ptr++;
+            lexpr_parse_compare(p);
+            lexpr_emit(p, ops[ii], 0, 0., -1);
+        }else
+            lexpr_emit(p, ops[ii], 0, 0., 0);
+        lexpr_skip(p);
+        if(*p->ptr != ')')
+            lexpr_error(p, "Expected )");
+        else
+            p->ptr++;
+        return;
+    }
+
+    index = lexpr_lookup(p->ex, name);
+    if(index < 0){
+        p->err = 1;
+        return;
+    }
+    lexpr_emit(p, LEXPR_OP_VAR, index, 0., 1);
+}
+
+static void lexpr_parse_unary(LEXPR_PARSER* p);
+
+static void lexpr_parse_power(LEXPR_PARSER* p){
+    lexpr_parse_primary(p);
+    lexpr_skip(p);
+    if(*p->ptr == '^'){
+        p->ptr++;
+        lexpr_parse_unary(p);
+        lexpr_emit(p, LEXPR_OP_POW, 0, 0., -1);
+    }
+}
+
+static void lexpr_parse_unary(LEXPR_PARSER* p){
+    lexpr_skip(p);
+    if(*p->ptr == '-'){
+        p->ptr++;
+        lexpr_parse_unary(p);
+        lexpr_emit(p, LEXPR_OP_NEG, 0, 0., 0);
+    }else
+        lexpr_parse_power(p);
+}
+
+static void lexpr_parse_term(LEXPR_PARSER* p){
+    char op;
+    lexpr_parse_unary(p);
+    while(!p->err){
+        lexpr_skip(p);
+        op = *p->ptr;
+        if(op != '*' && op != '/')
+            return;
+        p->ptr++;
+        lexpr_parse_unary(p);
+        lexpr_emit(p, op == '*' ? LEXPR_OP_MUL : LEXPR_OP_DIV, 0, 0., -1);
+    }
+}
+
+static void lexpr_parse_sum(LEXPR_PARSER* p){
+    char op;
+    lexpr_parse_term(p);
+    while(!p->err){
+        lexpr_skip(p);
+        op = *p->ptr;
+        if(op != '+' && op != '-')
+            return;
+        p->ptr++;
+        lexpr_parse_term(p);
+        lexpr_emit(p, op == '+' ? LEXPR_OP_ADD : LEXPR_OP_SUB, 0, 0., -1);
+    }
+}
+
+static void lexpr_parse_compare(LEXPR_PARSER* p){
+    int op;
+    lexpr_parse_sum(p);
+    lexpr_skip(p);
+    if(*p->ptr == '<' || *p->ptr == '>'){
+        if(p->ptr[1] == '=')
+            op = *p->ptr == '<' ? LEXPR_OP_LE : LEXPR_OP_GE;
+        else
+            op = *p->ptr == '<' ? LEXPR_OP_LT : LEXPR_OP_GT;
+        p->ptr += p->ptr[1] == '=' ? 2 : 1;
+        lexpr_parse_sum(p);
+        lexpr_emit(p, op, 0, 0., -1);
+    }
+}
+
+//******************************************************************************
+// Compile the text of an expression into eq
+static int lexpr_parse(LEXPR* ex, LEXPR_EQ* eq, const char* text){
+    LEXPR_PARSER p;
+    p.ex = ex;
+    p.eq = eq;
+    p.ptr = text;
+    p.depth = 0;
+    p.err = 0;
+    lexpr_parse_compare(&p);
+    lexpr_skip(&p);
+    if(!p.err && *p.ptr)
+        lexpr_error(&p, "Unexpected text");
+    return p.err;
+}
+
+//******************************************************************************
+static LEXPR_EQ* lexpr_new_eq(LEXPR* ex, const char* text){
+    LEXPR_EQ* eq;
+    if(ex->neq >= LEXPR_MAX_EQ){
+        printf("LEXPR: Too many definitions; \"%s\" is not allowed\n", text);
+        return NULL;
+    }else if(strlen(text) >= LEXPR_MAX_TEXT){
+        printf("LEXPR: Definition is too long: \"%s\"\n", text);
+        return NULL;
+    }
+    eq = &ex->eq[ex->neq];
+    memset(eq, 0, sizeof(LEXPR_EQ));
+    strcpy(eq->text, text);
+    eq->out = -1;
+    return eq;
+}
+
+//******************************************************************************
+int lexpr_derived(LEXPR* ex, const char* text){
+    char name[LEXPR_MAX_STR];
+    const char* equal;
+    LEXPR_EQ* eq;
+    unsigned int length;
+    int index;
+
+    eq = lexpr_new_eq(ex, text);
+    if(eq == NULL)
+        return 1;
+    // Split off the name
+    equal = strchr(text, '=');
+    if(equal == NULL){
+        printf("LEXPR: Expected name = expression in \"%s\"\n", text);
+        return 1;
+    }
+    while(isspace((unsigned char)*text))
+        text++;
+    for(length = equal - text; length > 0 && isspace((unsigned char)text[length-1]);
+            length--);
+    if(length >= LEXPR_MAX_STR){
+        printf("LEXPR: Name is too long in \"%s\"\n", eq->text);
+        return 1;
+    }
+    memcpy(name, text, length);
+    name[length] = '\0';
+    if(!lexpr_valid_name(name)){
+        printf("LEXPR: Invalid name in \"%s\"\n", eq->text);
+        return 1;
+    }
+    index = lexpr_lookup(ex, name);
+    if(index < 0)
+        return 1;
+    if(ex->var[index].kind == LEXPR_DERIVED){
+        printf("LEXPR: %s is defined twice\n", name);
+        return 1;
+    }else if(ex->var[index].kind == LEXPR_CHANNEL){
+        printf("LEXPR: %s is an input channel\n", name);
+        return 1;
+    }
+
+    if(lexpr_parse(ex, eq, equal+1))
+        return 1;
+    ex->var[index].kind = LEXPR_DERIVED;
+    ex->var[index].eq = ex->neq;
+    eq->out = index;
+    ex->neq++;
+    ex->compiled = 0;
+    return 0;
+}
+
+//******************************************************************************
+int lexpr_alarm(LEXPR* ex, const char* text){
+    LEXPR_EQ* eq;
+    eq = lexpr_new_eq(ex, text);
+    if(eq == NULL || lexpr_parse(ex, eq, text))
+        return 1;
+    ex->neq++;
+    ex->compiled = 0;
+    return 0;
+}
+
+//******************************************************************************
+// Depth-first sort of the definitions.  state is 0 before a definition is
+// visited, 1 while its dependencies are being visited, and 2 once it has
+// been placed in the order.
+static int lexpr_visit(LEXPR* ex, const unsigned int index, char* state,
+                unsigned int* count){
+    LEXPR_EQ* eq;
+    LEXPR_VAR* var;
+    unsigned int ii;
+
+    if(state[index] == 2)
+        return 0;
+    eq = &ex->eq[index];
+    if(state[index] == 1){
+        printf("LEXPR: Circular definition of %s\n", ex->var[eq->out].name);
+        return 1;
+    }
+    state[index] = 1;
+    eq->deps = 0;
+    for(ii=0; ii<eq->nprog; ii++){
+        if(eq->prog[ii].op != LEXPR_OP_VAR)
+            continue;
+        var = &ex->var[eq->prog[ii].arg];
+        if(var->kind == LEXPR_UNKNOWN){
+            printf("LEXPR: Unknown name %s in \"%s\"\n", var->name, eq->text);
+            return 1;
+        }else if(var->kind == LEXPR_DERIVED){
+            if(lexpr_visit(ex, var->eq, state, count))
+                return 1;
+            eq->deps |= ex->eq[var->eq].deps;
+        }else{
+            eq->deps |= (uint64_t)1 << eq->prog[ii].arg;
+            if(var->kind == LEXPR_CHANNEL)
+                var->used = 1;
+        }
+    }
+    state[index] = 2;
+    ex->order[(*count)++] = index;
+    return 0;
+}
+
+//******************************************************************************
+int lexpr_compile(LEXPR* ex){
+    char state[LEXPR_MAX_EQ];
+    unsigned int ii, count = 0, nbuffer;
+    LEXPR_VAR* var;
+
+    memset(state, 0, sizeof(state));
+    for(ii=0; ii<ex->nvar; ii++)
+        ex->var[ii].used = 0;
+    for(ii=0; ii<ex->neq; ii++)
+        if(lexpr_visit(ex, ii, state, &count))
+            return 1;
+
+    // Channels and derived values each get a block; the stack gets the rest
+    free(ex->buffer);
+    nbuffer = ex->nvar + LEXPR_MAX_STACK;
+    ex->buffer = malloc(nbuffer * ex->maxblock * sizeof(double));
+    if(ex->buffer == NULL){
+        printf("LEXPR: Failed to allocate the evaluation buffers\n");
+        return 1;
+    }
+    for(ii=0; ii<ex->nvar; ii++){
+        var = &ex->var[ii];
+        var->n = 1;
+        var->value = var->bind ? *var->bind : 0.;
+        var->last = var->value;
+        if(var->kind == LEXPR_SCALAR)
+            var->data = var->bind;
+        else if(var->kind == LEXPR_CHANNEL){
+            var->data = &ex->buffer[ii * ex->maxblock];
+            var->n = 0;
+        }else{
+            var->data = &ex->buffer[ii * ex->maxblock];
+            var->data[0] = var->value;
+        }
+    }
+    for(ii=0; ii<ex->neq; ii++)
+        ex->eq[ii].fresh = 0;
+    ex->dirty = 0;
+    ex->compiled = 1;
+    return 0;
+}
+
+//******************************************************************************
+void lexpr_block(LEXPR* ex, const double* data, const unsigned int channels,
+                const unsigned int samples){
+    unsigned int ii, jj, n;
+    LEXPR_VAR* var;
+
+    if(!ex->compiled)
+        return;
+    n = samples < ex->maxblock ? samples : ex->maxblock;
+    for(ii=0; ii<ex->nvar; ii++){
+        var = &ex->var[ii];
+        if(var->kind != LEXPR_CHANNEL || !var->used || var->column >= channels)
+            continue;
+        for(jj=0; jj<n; jj++)
+            var->data[jj] = var->slope * (data[jj*channels + var->column] - var->zero);
+        var->n = n;
+        ex->dirty |= (uint64_t)1 << ii;
+    }
+}
+
+
+// Apply a binary operation over two operands, broadcasting scalars.  x and
+// y are the operand values and the result is written in place of a.
+#define LEXPR_BINARY(EXPR) do{ \
+    if(a->n == 1 && b->n == 1){ \
+        x = a->data[0]; y = b->data[0]; out[0] = (EXPR); n = 1; \
+    }else if(b->n == 1){ \
+        n = a->n; y = b->data[0]; \
+        for(jj=0; jj<n; jj++){ x = a->data[jj]; out[jj] = (EXPR); } \
+    }else if(a->n == 1){ \
+        n = b->n; x = a->data[0]; \
+        for(jj=0; jj<n; jj++){ y = b->data[jj]; out[jj] = (EXPR); } \
+    }else{ \
+        n = a->n < b->n ? a->n : b->n; \
+        for(jj=0; jj<n; jj++){ x = a->data[jj]; y = b->data[jj]; out[jj] = (EXPR); } \
+    } }while(0)
+
+// Apply a function to one operand in place
+#define LEXPR_UNARY(EXPR) do{ \
+    n = a->n; \
+    for(jj=0; jj<n; jj++){ x = a->data[jj]; out[jj] = (EXPR); } \
+    }while(0)
+
+typedef struct {
+    double* data;
+    unsigned int n;
+} LEXPR_SLOT;
+
+//******************************************************************************
+static void lexpr_run(LEXPR* ex, LEXPR_EQ* eq, LEXPR_SLOT* result){
+    LEXPR_SLOT stack[LEXPR_MAX_STACK], *a, *b;
+    LEXPR_INST* inst;
+    LEXPR_VAR* var;
+    double *out, x, y;
+    unsigned int ii, jj, n, top = 0;
+    int binary;
+
+    for(ii=0; ii<eq->nprog; ii++){
+        inst = &eq->prog[ii];
+        if(inst->op == LEXPR_OP_CONST || inst->op == LEXPR_OP_VAR){
+            // Operands are referenced in place rather than copied
+            a = &stack[top++];
+            if(inst->op == LEXPR_OP_CONST){
+                a->data = &ex->buffer[(ex->nvar + top-1) * ex->maxblock];
+                a->data[0] = inst->value;
+                a->n = 1;
+            }else{
+                var = &ex->var[inst->arg];
+                a->data = var->data;
+                a->n = var->n;
+            }
+            continue;
+        }
+        // Results are written to the stack block at the result's depth.
+        // Operations are elementwise, so overwriting an operand is safe.
+        binary = (inst->op >= LEXPR_OP_ADD && inst->op <= LEXPR_OP_GE) ||
+                inst->op == LEXPR_OP_MIN || inst->op == LEXPR_OP_MAX;
+        out = &ex->buffer[(ex->nvar + top - 1 - binary) * ex->maxblock];
+        switch(inst->op){
+        case LEXPR_OP_NEG: a = &stack[top-1]; LEXPR_UNARY(-x); break;
+        case LEXPR_OP_ABS: a = &stack[top-1]; LEXPR_UNARY(fabs(x)); break;
+        case LEXPR_OP_SQRT: a = &stack[top-1]; LEXPR_UNARY(sqrt(x)); break;
+        case LEXPR_OP_EXP: a = &stack[top-1]; LEXPR_UNARY(exp(x)); break;
+        case LEXPR_OP_LOG: a = &stack[top-1]; LEXPR_UNARY(log(x)); break;
+        default:
+            a = &stack[top-2];
+            b = &stack[top-1];
+            top--;
+            switch(inst->op){
+            case LEXPR_OP_ADD: LEXPR_BINARY(x + y); break;
+            case LEXPR_OP_SUB: LEXPR_BINARY(x - y); break;
+            case LEXPR_OP_MUL: LEXPR_BINARY(x * y); break;
+            case LEXPR_OP_DIV: LEXPR_BINARY(x / y); break;
+            case LEXPR_OP_POW: LEXPR_BINARY(pow(x, y)); break;
+            case LEXPR_OP_LT: LEXPR_BINARY((double)(x < y)); break;
+            case LEXPR_OP_GT: LEXPR_BINARY((double)(x > y)); break;
+            case LEXPR_OP_LE: LEXPR_BINARY((double)(x <= y)); break;
+            case LEXPR_OP_GE: LEXPR_BINARY((double)(x >= y)); break;
+            case LEXPR_OP_MIN: LEXPR_BINARY(x < y ? x : y); break;
+            case LEXPR_OP_MAX: LEXPR_BINARY(x > y ? x : y); break;
+            }
+        }
+        a->data = out;
+        a->n = n;
+    }
+    *result = stack[0];
+}
+
+#undef LEXPR_BINARY
+#undef LEXPR_UNARY
+
+//******************************************************************************
+void lexpr_eval(LEXPR* ex){
+    LEXPR_SLOT result;
+    LEXPR_EQ* eq;
+    LEXPR_VAR* var;
+    unsigned int ii, jj;
+    unsigned long count;
+    double sum;
+    char active;
+
+    if(!ex->compiled)
+        return;
+
+    // Note which bound inputs have changed
+    for(ii=0; ii<ex->nvar; ii++){
+        var = &ex->var[ii];
+        if(var->kind == LEXPR_SCALAR && *var->bind != var->last){
+            var->last = *var->bind;
+            ex->dirty |= (uint64_t)1 << ii;
+        }
+    }
+
+    for(ii=0; ii<ex->neq; ii++){
+        eq = &ex->eq[ex->order[ii]];
+        eq->changed = 0;
+        if(eq->fresh && !(eq->deps & ex->dirty))
+            continue;
+        eq->fresh = 1;
+        lexpr_run(ex, eq, &result);
+
+        if(eq->out >= 0){
+            // Store the derived channel and its block mean
+            var = &ex->var[eq->out];
+            if(result.data != var->data)
+                memcpy(var->data, result.data, result.n * sizeof(double));
+            var->n = result.n;
+            sum = 0.;
+            for(jj=0; jj<result.n; jj++)
+                sum += result.data[jj];
+            var->value = result.n ? sum / result.n : NAN;
+            if(var->bind)
+                *var->bind = var->value;
+        }else{
+            // Count the samples in alarm
+            count = 0;
+            for(jj=0; jj<result.n; jj++)
+                count += result.data[jj] != 0. && !isnan(result.data[jj]);
+            active = count > 0;
+            eq->changed = active != eq->active;
+            if(active && !eq->active)
+                eq->events++;
+            eq->active = active;
+            eq->count = count;
+        }
+    }
+    ex->dirty = 0;
+}
+
+//******************************************************************************
+void lexpr_free(LEXPR* ex){
+    free(ex->buffer);
+    ex->buffer = NULL;
+    ex->compiled = 0;
+}
+
+#endif
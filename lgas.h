@@ -3,16 +3,32 @@
 .   These functions measure gas flows assuming the U12 is connected to a pair of
 .   Teledyne-Hastings thermal mass flow meters measuring the flow of oxygen and
 .   methane.
+.
+.   Each pair of meters is described by an LGAS context that holds its U12,
+.   channels, calibration, and gas properties.  The lgas_ functions only
+.   touch the context they are given, so several pairs (on one U12 or
+.   several) can be read from separate threads.  Contexts that share a U12
+.   should share a lock so that their reads are not interleaved in the
+.   driver.
+.
+.   The original functions (get_gas(), zero_gas(), and the conversions) are
+.   kept as wrappers that operate on the LGAS_ globals.
+.
+.   Define LGAS_NO_U12 before including this file to get the calibration
+.   globals and unit conversions without the U12 driver (e.g. in liblab).
 */
 
 #ifndef __LGAS
 #define __LGAS
 
+#ifndef LGAS_NO_U12
 #include <ljacklm.h>
+#include <pthread.h>
+#endif
 #include <stdio.h>
 #include <unistd.h>
 
-#define LGAS_VERSION 1.0
+#define LGAS_VERSION 1.1
 
 
 
@@ -41,14 +57,77 @@ double LGAS_PREF_PA = 100000.;
 
 
 
+/********************************
+ *                              *
+ *            Types             *
+ *                              *
+ ********************************/
+
+typedef struct {
+    long u12_id;                // U12 local ID; -1 for the first found
+    long o2_channel;            // Differential channel of the oxygen meter
+    long fg_channel;            // Differential channel of the fuel gas meter
+    // Calibration parameters
+    double o2_slope_scfh;       // scfh per volt
+    double o2_offset_scfh;      // scfh
+    double fg_slope_scfh;       // scfh per volt
+    double fg_offset_scfh;      // scfh
+    // Properties
+    double o2_mw;
+    double fg_mw;
+    double tref_K;
+    double pref_Pa;
+#ifndef LGAS_NO_U12
+    pthread_mutex_t* lock;      // Shared by contexts on the same U12; or NULL
+#endif
+} LGAS;
+
+
+
 /********************************
  *                              *
  *          Prototypes          *
  *                              *
  ********************************/
 
+/* LGAS_INIT
+.   Initialize a context from the current values of the LGAS_ globals, which
+.   hold the defaults unless the host has changed them.  The lock is NULL.
+*/
+void lgas_init(LGAS* gas);
+
+#ifndef LGAS_NO_U12
+/* LGAS_GET
+.   Obtain the differential voltages of a meter pair and apply its
+.   calibration.  Both channels are read under the context's lock.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lgas_get(LGAS* gas, double * o2_scfh, double * fg_scfh);
+
+/* LGAS_ZERO
+.   Collect zero flow rate measurements to set the context's offsets.  If a
+.   measurement does not appear to be zero, the operation is aborted and a
+.   non-zero error code is returned.
+*/
+int lgas_zero(LGAS* gas);
+#endif
+
+/* LGAS_MOLES
+.   Convert from scfh to molar flow at the context's reference conditions.
+.   Returns molar flow in moles per second.
+*/
+double lgas_moles(const LGAS* gas, double scfh);
+
+/* LGAS_O2_GPS, LGAS_FG_GPS
+.   Convert the oxygen or fuel gas flow in scfh to grams per second.
+*/
+double lgas_o2_gps(const LGAS* gas, double scfh);
+double lgas_fg_gps(const LGAS* gas, double scfh);
+
+#ifndef LGAS_NO_U12
 /* GET_GAS
-.   Obtain differential the voltages from the U12 and apply the calibration 
+.   Obtain differential the voltages from the U12 and apply the calibration
 .   constants.
 .
 .   Returns 0 on success and 1 on an error.
@@ -62,6 +141,7 @@ int get_gas(double * o2_scfh, double * fg_scfh);
 .   a non-zero error code is returned.
 */
 int zero_gas(void);
+#endif
 
 /* CONVERT_TO_MASS
 .   Convert from scfh to a mass flow; requires the molecular weight of the gas.
@@ -84,94 +164,163 @@ double convert_to_moles(double scfh);
 
 
 //******************************************************************************
-int get_gas(double * o2_scfh, double * fg_scfh){
+void lgas_init(LGAS* gas){
+    gas->u12_id = LGAS_U12_ID;
+    gas->o2_channel = LGAS_O2_CHANNEL;
+    gas->fg_channel = LGAS_FG_CHANNEL;
+    gas->o2_slope_scfh = LGAS_O2_SLOPE_SCFH;
+    gas->o2_offset_scfh = LGAS_O2_OFFSET_SCFH;
+    gas->fg_slope_scfh = LGAS_FG_SLOPE_SCFH;
+    gas->fg_offset_scfh = LGAS_FG_OFFSET_SCFH;
+    gas->o2_mw = LGAS_O2_MW;
+    gas->fg_mw = LGAS_FG_MW;
+    gas->tref_K = LGAS_TREF_K;
+    gas->pref_Pa = LGAS_PREF_PA;
+#ifndef LGAS_NO_U12
+    gas->lock = NULL;
+#endif
+}
+
+
+#ifndef LGAS_NO_U12
+//******************************************************************************
+// Read one differential channel.  The caller holds the lock.
+static int lgas_read(LGAS* gas, const long channel, const char* fn,
+                const char* what, float* volts){
     long err, over;
     char error_string[50];
     const long gain = 3;    // +/- 5V range
-    float volts;
 
-    // Read in the oxygen flow
-    err = EAnalogIn( &LGAS_U12_ID, 0, LGAS_O2_CHANNEL, gain, &over, &volts);
+    err = EAnalogIn( &gas->u12_id, 0, channel, gain, &over, volts);
     if(err){
         GetErrorString(err,error_string);
-        printf( "GET_GAS: Error durring oxygen measurement.\n"
-                "Received error: %s\n", error_string);
+        printf( "%s: Error durring %s measurement.\n"
+                "Received error: %s\n", fn, what, error_string);
         return 1;
     }
     if(over)
-        printf( "GET_GAS: Oxygen voltage exceeded measurement range.\n");
-    // Apply the calibration    
-    *o2_scfh = LGAS_O2_SLOPE_SCFH * volts + LGAS_O2_OFFSET_SCFH;
+        printf( "%s: %s voltage exceeded measurement range.\n", fn, what);
+    return 0;
+}
 
 
-    // Read in the FG flow
-    err = EAnalogIn( &LGAS_U12_ID, 0, LGAS_FG_CHANNEL, gain, &over, &volts);
-    if(err){
-        GetErrorString(err,error_string);
-        printf( "GET_GAS: Error durring fuel gas measurement.\n"
-                "Received error: %s\n", error_string);
+//******************************************************************************
+int lgas_get(LGAS* gas, double * o2_scfh, double * fg_scfh){
+    float o2_volts, fg_volts;
+    int err;
+
+    if(gas->lock)
+        pthread_mutex_lock(gas->lock);
+    err = lgas_read(gas, gas->o2_channel, "LGAS_GET", "oxygen", &o2_volts) ||
+            lgas_read(gas, gas->fg_channel, "LGAS_GET", "fuel gas", &fg_volts);
+    if(gas->lock)
+        pthread_mutex_unlock(gas->lock);
+    if(err)
         return 1;
-    }
-    if(over)
-        printf( "GET_GAS: Fuel gas voltage exceeded measurement range.\n");
-    // Apply the calibration
-    *fg_scfh = LGAS_FG_SLOPE_SCFH * volts + LGAS_FG_OFFSET_SCFH;
 
+    // Apply the calibration
+    *o2_scfh = gas->o2_slope_scfh * o2_volts + gas->o2_offset_scfh;
+    *fg_scfh = gas->fg_slope_scfh * fg_volts + gas->fg_offset_scfh;
     return 0;
 }
 
 
-int zero_gas(void){
-    long err, over;
-    char error_string[50];
-    const long gain = 3;    // +/- 5V range
-	const float small = 1.;
+//******************************************************************************
+int lgas_zero(LGAS* gas){
+    const float small = 1.;
     float volts;
+    int err;
 
     // Read in the oxygen flow
-    err = EAnalogIn( &LGAS_U12_ID, 0, LGAS_O2_CHANNEL, gain, &over, &volts);
-    if(err){
-        GetErrorString(err,error_string);
-        printf( "ZERO_GAS: Error durring oxygen measurement.\n"
-                "Received error: %s\n", error_string);
+    if(gas->lock)
+        pthread_mutex_lock(gas->lock);
+    err = lgas_read(gas, gas->o2_channel, "LGAS_ZERO", "oxygen", &volts);
+    if(gas->lock)
+        pthread_mutex_unlock(gas->lock);
+    if(err)
+        return 1;
+
+    // If the voltage isn't small!
+    if(volts*volts > small*small){
+        printf("LGAS_ZERO: Oxygen voltage exceeded %f V\n", volts);
         return 1;
+    }else{
+        // Apply the calibration
+        gas->o2_offset_scfh = - volts * gas->o2_slope_scfh;
     }
-    if(over){
-        printf( "ZERO_GAS: Oxygen voltage exceeded measurement range.\n");
-	}
-
-	// If the voltage isn't small!
-	if(volts*volts > small*small){
-		printf("ZERO_GAS: Oxygen voltage exceeded %f V\n", volts);
-		return 1;
-	}else{
-		// Apply the calibration
-		LGAS_O2_OFFSET_SCFH = - volts * LGAS_O2_SLOPE_SCFH;
-	}
 
     // Read in the FG flow
-    err = EAnalogIn( &LGAS_U12_ID, 0, LGAS_FG_CHANNEL, gain, &over, &volts);
-    if(err){
-        GetErrorString(err,error_string);
-        printf( "ZERO_GAS: Error durring fuel gas measurement.\n"
-                "Received error: %s\n", error_string);
+    if(gas->lock)
+        pthread_mutex_lock(gas->lock);
+    err = lgas_read(gas, gas->fg_channel, "LGAS_ZERO", "fuel gas", &volts);
+    if(gas->lock)
+        pthread_mutex_unlock(gas->lock);
+    if(err)
         return 1;
+
+    // If the voltage isn't small!
+    if(volts*volts > small*small){
+        printf("LGAS_ZERO: Fuel gas voltage exceeded %f V\n", volts);
+        return 1;
+    }else{
+        // Apply the calibration
+        gas->fg_offset_scfh = - volts * gas->fg_slope_scfh;
     }
-    if(over){
-        printf( "ZERO_GAS: Fuel gas voltage exceeded measurement range.\n");
-	}
-
-	// If the voltage isn't small!
-	if(volts*volts > small*small){
-		printf("ZERO_GAS: Fuel gas voltage exceeded %f V\n", volts);
-		return 1;
-	}else{
-		// Apply the calibration
-		LGAS_FG_OFFSET_SCFH = - volts * LGAS_FG_SLOPE_SCFH;
-	}
 
     return 0;
 }
+#endif
+
+
+//******************************************************************************
+double lgas_moles(const LGAS* gas, double scfh){
+    static const double R = 8.314;
+    double ncms;
+    // convert to normal cubic meters per second
+    ncms = 7.865e-6 * scfh;
+    return gas->pref_Pa * ncms / R / gas->tref_K;
+}
+
+
+//******************************************************************************
+double lgas_o2_gps(const LGAS* gas, double scfh){
+    return gas->o2_mw * lgas_moles(gas, scfh);
+}
+
+
+//******************************************************************************
+double lgas_fg_gps(const LGAS* gas, double scfh){
+    return gas->fg_mw * lgas_moles(gas, scfh);
+}
+
+
+#ifndef LGAS_NO_U12
+//******************************************************************************
+int get_gas(double * o2_scfh, double * fg_scfh){
+    LGAS gas;
+    int err;
+
+    lgas_init(&gas);
+    err = lgas_get(&gas, o2_scfh, fg_scfh);
+    // The U12 driver may resolve an ID of -1
+    LGAS_U12_ID = gas.u12_id;
+    return err;
+}
+
+
+int zero_gas(void){
+    LGAS gas;
+    int err;
+
+    lgas_init(&gas);
+    err = lgas_zero(&gas);
+    // Offsets are kept even if only the first channel succeeded
+    LGAS_U12_ID = gas.u12_id;
+    LGAS_O2_OFFSET_SCFH = gas.o2_offset_scfh;
+    LGAS_FG_OFFSET_SCFH = gas.fg_offset_scfh;
+    return err;
+}
+#endif
 
 
 
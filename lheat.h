@@ -0,0 +1,198 @@
+/*
+.
+.   Tools for the coolant and plate heat balances
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LHEAT estimates the heat carried away by the air/water coolant mixture
+.   and the heat conducted through the plate.  The functions take all of
+.   their inputs as arguments so that they can be used by the live monitor
+.   and by the offline reprocessing tool alike.
+.
+*/
+
+
+#ifndef __LHEAT
+#define __LHEAT
+
+
+// Add some headers
+#include <math.h>
+#include "psat.h"           // For water/steam properties
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LHEAT_VERSION
+Date
+Notes
+
+**1.0
+Original version.  Moved from the commented-out coolant_heat() and
+plate_heat() in monitor.c.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LHEAT_VERSION 1.0
+
+// Area of the 1/32" coolant air orifice
+#define LHEAT_ORIFICE_MM2   0.4948
+// Smallest plate thermocouple difference used for the conductivity (C)
+#define LHEAT_PLATE_MIN_C   0.1
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LHEAT_WATER_GPS
+.   Convert a coolant water flow in gallons per hour to grams per second.
+*/
+double lheat_water_gps(const double water_gph);
+
+/* LHEAT_AIR_GPS
+.   Convert the coolant air pressure upstream of the choked orifice in psig
+.   to a mass flow in grams per second.
+*/
+double lheat_air_gps(const double air_psig);
+
+/* LHEAT_COOLANT
+.   How much heat went into the coolant?
+.
+.   air_gps     Air mass flow in grams per second
+.   water_gps   Water mass flow in grams per second
+.   Tlow_C      Coolant mixture inlet temperature (C)
+.   Thigh_C     Coolant mixture outlet temperature (C)
+.   Q_kW        The heat in kW
+.
+.   Returns 0 on success and 1 if a temperature is outside the range of the
+.   water properties; Q_kW is not changed.
+*/
+int lheat_coolant(const double air_gps, const double water_gps,
+                const double Tlow_C, const double Thigh_C, double* Q_kW);
+
+/* LHEAT_PLATE
+.   Calculate the heat conducted through the plate in kW and the peak plate
+.   temperature in degrees C.
+.
+.   Thigh_C, Tlow_C         Upper and lower plate thermocouples (C)
+.   coolTlow_C, coolThigh_C Coolant inlet and outlet temperatures (C)
+.   Q_kW                    Heat conducted through the plate (kW)
+.   Tpeak_C                 Peak plate temperature (C)
+.
+.   The peak temperature depends on the plate conductivity, which is
+.   estimated from the ratio of the two plate temperatures.  When they are
+.   within about LHEAT_PLATE_MIN_C of one another (a cold plate), that
+.   ratio is meaningless and Tpeak_C is NAN.
+*/
+void lheat_plate(const double Thigh_C, const double Tlow_C,
+                const double coolTlow_C, const double coolThigh_C,
+                double* Q_kW, double* Tpeak_C);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+double lheat_water_gps(const double water_gph){
+    return 1.05139 * water_gph;
+}
+
+//******************************************************************************
+double lheat_air_gps(const double air_psig){
+    return (air_psig + 14.7) * 0.015907485 * LHEAT_ORIFICE_MM2;
+}
+
+//******************************************************************************
+int lheat_coolant(const double air_gps, const double water_gps,
+                const double Tlow_C, const double Thigh_C, double* Q_kW){
+    double  Thigh_K,        // High temperature in K
+            Tlow_K,         // Low temperature in K
+            water_vap1_gps, // The water vapor flow rate at the inlet
+            water_vap2_gps, // The water vapor flow rate at the outlet
+            dh1,            // Latent enthalpy at the inlet
+            dh2,            // Latent enthalpy at the outlet
+            xv1,            // Vapor mole fraction at the inlet
+            xv2,            // Vapor mole fraction at the outlet
+            Q;              // The result; heat
+    // estimates for inlet and outlet total pressures in MPa
+    static const double ptot1 = 0.13586, ptot2 = 0.101325;
+    // molar weights for water and air
+    static const double ww = 18.015, wa = 28.97;
+    // specific heat of liquid water and air in J/g/K
+    static const double cpw = 4.182, cpa = 1.005;
+
+    // Go from C to K
+    Tlow_K = Tlow_C + 273.15;
+    Thigh_K = Thigh_C + 273.15;
+
+    // Latent heats in J/g
+    dh1 = latent(Tlow_K);
+    dh2 = latent(Thigh_K);
+    // d-less partial pressures
+    xv1 = psat(Tlow_K)/ptot1;
+    xv2 = psat(Thigh_K)/ptot2;
+
+    // If we're below the triple point or above the critical point
+    // Something is VERY VERY WRONG
+    if(xv1<0 || xv2<0) return 1;
+    // If the temperature has exceeded the saturation temperature at this pressure
+    // The estimate will be rough
+    if(xv1 >= 1.) water_vap1_gps = water_gps;
+    else water_vap1_gps = air_gps * (ww / wa) * xv1 / (1. - xv1);
+
+    if(xv2 >= 1.) water_vap2_gps = water_gps;
+    else water_vap2_gps = air_gps * (ww / wa) * xv2 / (1. - xv2);
+
+    // Check to see if all the water is vapor.  This can happen at low water
+    // flow rates
+    if(water_vap1_gps > water_gps) water_vap1_gps = water_gps;
+    if(water_vap2_gps > water_gps) water_vap2_gps = water_gps;
+
+    Q = (air_gps*cpa + water_gps*cpw)*(Thigh_K - Tlow_K) + \
+        water_vap2_gps * dh2 - water_vap1_gps * dh1;
+
+    // Convert to kW
+    *Q_kW = .001 * Q;
+    return 0;
+}
+
+//******************************************************************************
+void lheat_plate(const double Thigh_C, const double Tlow_C,
+                const double coolTlow_C, const double coolThigh_C,
+                double* Q_kW, double* Tpeak_C){
+    double dT, n, Tc, den;
+    // Nominal temperature drop across the plate
+    dT = 1.4556 * (Thigh_C - Tlow_C);
+    Tc = 0.5*(coolTlow_C + coolThigh_C);
+    // dimensionless plate conductivity
+    den = 1.0032*Thigh_C - 1.0005*Tlow_C;
+    if(!(fabs(den) >= LHEAT_PLATE_MIN_C))
+        *Tpeak_C = NAN;
+    else{
+        n = 1. + (1.894*Tlow_C - 1.207*Thigh_C) / den;
+        *Tpeak_C = (3.903 + n)*dT + Tc;
+    }
+    *Q_kW = .0042 * dT;
+}
+
+#endif
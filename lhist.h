@@ -0,0 +1,230 @@
+/*
+.
+.   Tools for keeping the recent history of a value at several resolutions
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LHIST keeps a value's history in cascaded rings of time buckets.  Each
+.   bucket holds the minimum, mean, and maximum of the values added during
+.   its period.  Level 0 buckets span the shortest period; when one closes,
+.   it is folded into the open bucket of the next level, and so on, so a
+.   value is only ever touched once per level and the memory is fixed no
+.   matter how long the history runs.
+.
+.   With the default periods of 1 s, 10 s, and 60 s and LHIST_LEN buckets
+.   per level, a history spans 2 minutes at 1 s, 20 minutes at 10 s, and 2
+.   hours at 1 minute.  Bucket boundaries are multiples of the period on
+.   the caller's clock, so each period must be a whole multiple of the one
+.   below it.  Periods with no values are kept as empty buckets.
+.
+.   The rings are read back with lhist_series() and drawn with the
+.   sparkline and trend widgets in ldisplay.h.
+.
+*/
+
+
+#ifndef __LHIST
+#define __LHIST
+
+
+// Add some headers
+#include <math.h>
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LHIST_VERSION
+Date
+Notes
+
+**1.0
+Original version.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LHIST_VERSION 1.0
+
+#define LHIST_LEVELS    3       // Number of resolutions
+#define LHIST_LEN       120     // Buckets kept at each resolution
+// Default bucket periods (s)
+#define LHIST_PERIODS   {1., 10., 60.}
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    double min, max;
+    double sum;             // The mean is sum / n
+    unsigned long n;        // Number of values; 0 if empty
+} LHIST_BIN;
+
+typedef struct {
+    double period[LHIST_LEVELS];    // Bucket period at each level (s)
+    double index[LHIST_LEVELS];     // Open bucket; floor(time / period)
+    LHIST_BIN open[LHIST_LEVELS];   // Bucket being filled at each level
+    LHIST_BIN ring[LHIST_LEVELS][LHIST_LEN];    // Closed buckets
+    unsigned int head[LHIST_LEVELS];    // Where the next closed bucket goes
+    unsigned int count[LHIST_LEVELS];   // Closed buckets kept
+} LHIST;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LHIST_INIT
+.   Initialize an empty history.  period is LHIST_LEVELS bucket periods in
+.   seconds, shortest first, or NULL for LHIST_PERIODS.
+*/
+void lhist_init(LHIST* h, const double* period);
+
+/* LHIST_ADD
+.   Add a value x at time t (s, on any steady clock).  Buckets whose periods
+.   have ended are closed first.  NaN values only advance the time.
+*/
+void lhist_add(LHIST* h, const double t, const double x);
+
+/* LHIST_SERIES
+.   Copy the last n closed buckets of a level, oldest first, to min, mean,
+.   and max (any of which may be NULL).  Empty buckets and any buckets older
+.   than the history are NAN.
+.
+.   Returns the number of buckets with values.
+*/
+unsigned int lhist_series(const LHIST* h, const unsigned int level,
+                double* min, double* mean, double* max, const unsigned int n);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+static void lhist_clear(LHIST_BIN* bin){
+    bin->min = bin->max = NAN;
+    bin->sum = 0.;
+    bin->n = 0;
+}
+
+//******************************************************************************
+static void lhist_fold(LHIST_BIN* dest, const LHIST_BIN* src){
+    if(src->n == 0)
+        return;
+    if(dest->n == 0 || src->min < dest->min)
+        dest->min = src->min;
+    if(dest->n == 0 || src->max > dest->max)
+        dest->max = src->max;
+    dest->sum += src->sum;
+    dest->n += src->n;
+}
+
+//******************************************************************************
+void lhist_init(LHIST* h, const double* period){
+    static const double def[LHIST_LEVELS] = LHIST_PERIODS;
+    unsigned int ii;
+    for(ii=0; ii<LHIST_LEVELS; ii++){
+        h->period[ii] = period ? period[ii] : def[ii];
+        h->index[ii] = NAN;
+        lhist_clear(&h->open[ii]);
+        h->head[ii] = h->count[ii] = 0;
+    }
+}
+
+//******************************************************************************
+// Close buckets at a level until the open bucket contains t
+static void lhist_advance(LHIST* h, const unsigned int level, const double t){
+    double index;
+    unsigned int skip;
+
+    index = floor(t / h->period[level]);
+    if(isnan(h->index[level])){
+        h->index[level] = index;
+        return;
+    }
+    // A clock that steps back just keeps filling the open bucket
+    if(index <= h->index[level])
+        return;
+    // The closed bucket belongs to the next level's open bucket, which has
+    // not advanced yet
+    if(level+1 < LHIST_LEVELS)
+        lhist_fold(&h->open[level+1], &h->open[level]);
+    // Close the open bucket and any empty ones after it, up to a full ring
+    skip = index - h->index[level] > LHIST_LEN ?
+            LHIST_LEN : (unsigned int)(index - h->index[level]);
+    while(skip--){
+        h->ring[level][h->head[level]] = h->open[level];
+        h->head[level] = (h->head[level] + 1) % LHIST_LEN;
+        if(h->count[level] < LHIST_LEN)
+            h->count[level]++;
+        lhist_clear(&h->open[level]);
+    }
+    h->index[level] = index;
+}
+
+//******************************************************************************
+void lhist_add(LHIST* h, const double t, const double x){
+    unsigned int ii;
+    // Lower levels close first so that their buckets fold into the right
+    // bucket above
+    for(ii=0; ii<LHIST_LEVELS; ii++)
+        lhist_advance(h, ii, t);
+    if(isnan(x))
+        return;
+    if(h->open[0].n == 0 || x < h->open[0].min)
+        h->open[0].min = x;
+    if(h->open[0].n == 0 || x > h->open[0].max)
+        h->open[0].max = x;
+    h->open[0].sum += x;
+    h->open[0].n++;
+}
+
+//******************************************************************************
+unsigned int lhist_series(const LHIST* h, const unsigned int level,
+                double* min, double* mean, double* max, const unsigned int n){
+    const LHIST_BIN* bin;
+    unsigned int ii, age, found = 0;
+
+    for(ii=0; ii<n; ii++){
+        // The newest closed bucket is 1 behind the head
+        age = n - ii;
+        bin = NULL;
+        if(level < LHIST_LEVELS && age <= h->count[level])
+            bin = &h->ring[level][(h->head[level] + LHIST_LEN - age) % LHIST_LEN];
+        if(bin && bin->n){
+            found++;
+            if(min) min[ii] = bin->min;
+            if(mean) mean[ii] = bin->sum / bin->n;
+            if(max) max[ii] = bin->max;
+        }else{
+            if(min) min[ii] = NAN;
+            if(mean) mean[ii] = NAN;
+            if(max) max[ii] = NAN;
+        }
+    }
+    return found;
+}
+
+#endif
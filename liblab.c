@@ -0,0 +1,125 @@
+/*
+.
+.   liblab.so
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   This is the single translation unit that defines the header-only tools
+.   for the shared library.  The interface is documented in liblab.h.
+.
+*/
+
+#define LGAS_NO_U12         // The library does not need the U12 driver
+#include "liblab.h"
+#include "psat.h"
+#include "ltc.h"
+#include "lheat.h"
+#include "lgas.h"
+#include "lrobust.h"
+#include <stdlib.h>
+#include <math.h>
+
+
+//******************************************************************************
+void llab_psat(const double* T_K, double* p_MPa, const unsigned int n){
+    unsigned int ii;
+    for(ii=0; ii<n; ii++)
+        p_MPa[ii] = psat(T_K[ii]);
+}
+
+//******************************************************************************
+void llab_latent(const double* T_K, double* hfg, const unsigned int n){
+    unsigned int ii;
+    for(ii=0; ii<n; ii++)
+        hfg[ii] = latent(T_K[ii]);
+}
+
+//******************************************************************************
+void llab_k_mv(const double* T_C, double* mV, const unsigned int n){
+    unsigned int ii;
+    for(ii=0; ii<n; ii++)
+        mV[ii] = ltc_k_mv(T_C[ii]);
+}
+
+//******************************************************************************
+void llab_k_t(const double* volts, const double* Tcj_C,
+                const unsigned int ntcj, double* T_C, const unsigned int n){
+    unsigned int ii;
+    if(ntcj == 1)
+        for(ii=0; ii<n; ii++)
+            T_C[ii] = ltc_k_t(volts[ii], Tcj_C[0]);
+    else
+        for(ii=0; ii<n; ii++)
+            T_C[ii] = ltc_k_t(volts[ii], Tcj_C[ii]);
+}
+
+//******************************************************************************
+void llab_gas_scfh(const double* volts, double* scfh, const unsigned int n,
+                const double slope, const double offset){
+    unsigned int ii;
+    for(ii=0; ii<n; ii++)
+        scfh[ii] = slope * volts[ii] + offset;
+}
+
+//******************************************************************************
+void llab_gas_gps(const double* scfh, double* gps, const unsigned int n,
+                const double mw){
+    unsigned int ii;
+    // convert_to_mass() is linear, so the factor is found once
+    const double factor = convert_to_mass(1., mw);
+    for(ii=0; ii<n; ii++)
+        gps[ii] = factor * scfh[ii];
+}
+
+//******************************************************************************
+unsigned int llab_coolant(const double* air_gps, const double* water_gps,
+                const double* Tlow_C, const double* Thigh_C, double* Q_kW,
+                const unsigned int n){
+    unsigned int ii, bad = 0;
+    for(ii=0; ii<n; ii++)
+        if(lheat_coolant(air_gps[ii], water_gps[ii], Tlow_C[ii], Thigh_C[ii],
+                &Q_kW[ii])){
+            Q_kW[ii] = NAN;
+            bad++;
+        }
+    return bad;
+}
+
+//******************************************************************************
+void llab_plate(const double* Thigh_C, const double* Tlow_C,
+                const double* coolTlow_C, const double* coolThigh_C,
+                double* Q_kW, double* Tpeak_C, const unsigned int n){
+    unsigned int ii;
+    for(ii=0; ii<n; ii++)
+        lheat_plate(Thigh_C[ii], Tlow_C[ii], coolTlow_C[ii], coolThigh_C[ii],
+                &Q_kW[ii], &Tpeak_C[ii]);
+}
+
+//******************************************************************************
+int llab_blocks(const double* data, const unsigned int channels,
+                const unsigned int samples, const unsigned int navg,
+                const char* mode, const double k, const double trim,
+                double* out, unsigned long* rejected){
+    LROB rob;
+    double* work;
+    unsigned int ii, jj, nblock;
+
+    if(navg == 0 || lrob_init(&rob, mode, k, trim))
+        return 1;
+    work = malloc(navg * sizeof(double));
+    if(work == NULL)
+        return 1;
+    nblock = samples / navg;
+    for(ii=0; ii<nblock; ii++)
+        for(jj=0; jj<channels; jj++)
+            out[ii*channels + jj] = lrob_estimate(&rob,
+                    &data[(size_t)ii*navg*channels + jj], channels, navg, work);
+    free(work);
+    if(rejected)
+        *rejected = rob.rejected;
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+.
+.   Public interface to liblab.so
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   The numerical tools in psat.h, ltc.h, lheat.h, lgas.h, and lrobust.h are
+.   header-only; their functions and globals are defined where they are
+.   included, so only one translation unit of a program may include each
+.   of them.  liblab.so compiles them once (see liblab.c) and this header
+.   declares them, so any number of translation units can include it and
+.   link with -llab instead.  Do not include it alongside the headers it
+.   replaces in the same program.
+.
+.   The library also adds batch versions of the scalar functions.  Each one
+.   walks whole arrays in a single call, so callers like py/liblab.py pay
+.   the call overhead once per array rather than once per value.  Outputs
+.   may not alias inputs unless noted.
+.
+*/
+
+
+#ifndef __LIBLAB
+#define __LIBLAB
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LLAB_VERSION
+Date
+Notes
+
+**1.0
+Original version.  psat, latent, type K thermocouples, gas and heat
+balances, and robust block reduction.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LLAB_VERSION 1.0
+
+
+
+/****************************
+ *                          *
+ *     Scalar functions     *
+ *                          *
+ ****************************/
+
+// See psat.h
+double psat(const double T);
+double latent(const double T);
+
+// See ltc.h
+double ltc_k_mv(const double T_C);
+double ltc_k_t(const double volts, const double Tcj_C);
+
+// See lheat.h
+double lheat_water_gps(const double water_gph);
+double lheat_air_gps(const double air_psig);
+int lheat_coolant(const double air_gps, const double water_gps,
+                const double Tlow_C, const double Thigh_C, double* Q_kW);
+void lheat_plate(const double Thigh_C, const double Tlow_C,
+                const double coolTlow_C, const double coolThigh_C,
+                double* Q_kW, double* Tpeak_C);
+
+// See lgas.h; the U12 functions are not part of the library
+extern double LGAS_O2_SLOPE_SCFH, LGAS_O2_OFFSET_SCFH;
+extern double LGAS_FG_SLOPE_SCFH, LGAS_FG_OFFSET_SCFH;
+extern double LGAS_O2_MW, LGAS_FG_MW, LGAS_TREF_K, LGAS_PREF_PA;
+double convert_to_mass(double scfh, double mw);
+double convert_to_moles(double scfh);
+
+// See lrobust.h
+double lrob_select(double* x, const unsigned int n, const unsigned int k);
+
+
+
+/****************************
+ *                          *
+ *     Batch functions      *
+ *                          *
+ ****************************/
+
+/* LLAB_PSAT, LLAB_LATENT
+.   Apply psat() or latent() to T_K[0..n-1].  Out of range temperatures
+.   give the same codes as the scalar functions.
+*/
+void llab_psat(const double* T_K, double* p_MPa, const unsigned int n);
+void llab_latent(const double* T_K, double* hfg, const unsigned int n);
+
+/* LLAB_K_MV
+.   Type K voltages in mV for junctions at T_C[0..n-1] referenced to 0 C.
+*/
+void llab_k_mv(const double* T_C, double* mV, const unsigned int n);
+
+/* LLAB_K_T
+.   Type K junction temperatures in C for voltages in V and cold junction
+.   temperatures in C.  Tcj_C has n values, or 1 to use the same cold
+.   junction for every voltage (ntcj).  Out of range values give NAN.
+*/
+void llab_k_t(const double* volts, const double* Tcj_C,
+                const unsigned int ntcj, double* T_C, const unsigned int n);
+
+/* LLAB_GAS_SCFH
+.   Apply a flow meter calibration, scfh = slope * volts + offset.
+*/
+void llab_gas_scfh(const double* volts, double* scfh, const unsigned int n,
+                const double slope, const double offset);
+
+/* LLAB_GAS_GPS
+.   Convert volume flows in scfh to mass flows in g/s for a gas with
+.   molecular weight mw.  scfh and gps may be the same array.
+*/
+void llab_gas_gps(const double* scfh, double* gps, const unsigned int n,
+                const double mw);
+
+/* LLAB_COOLANT
+.   Coolant heat in kW for n operating points.  Points with a temperature
+.   outside the range of the water properties give NAN.  Returns the
+.   number of such points.
+*/
+unsigned int llab_coolant(const double* air_gps, const double* water_gps,
+                const double* Tlow_C, const double* Thigh_C, double* Q_kW,
+                const unsigned int n);
+
+/* LLAB_PLATE
+.   Plate heat in kW and peak plate temperature in C for n operating
+.   points.
+*/
+void llab_plate(const double* Thigh_C, const double* Tlow_C,
+                const double* coolTlow_C, const double* coolThigh_C,
+                double* Q_kW, double* Tpeak_C, const unsigned int n);
+
+/* LLAB_BLOCKS
+.   Reduce interleaved samples to one value per channel per block of navg
+.   samples with an lrobust.h estimator, as the monitor does with each
+.   thermocouple block.
+.
+.   data        samples x channels interleaved values
+.   mode, k, trim
+.               Estimator settings; see lrob_init()
+.   out         (samples / navg) x channels results; a final partial
+.               block is ignored
+.   rejected    If not NULL, receives the total number of samples rejected
+.
+.   Returns 0 on success and 1 on an invalid mode or a memory error.
+*/
+int llab_blocks(const double* data, const unsigned int channels,
+                const unsigned int samples, const unsigned int navg,
+                const char* mode, const double k, const double trim,
+                double* out, unsigned long* rejected);
+
+#endif
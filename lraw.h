@@ -0,0 +1,229 @@
+/*
+.
+.   Tools for storing samples as raw integer ADC counts
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LRAW converts blocks of voltages to integer counts at the resolution of
+.   the converter and back.  Counts are stored as 16-bit integers for
+.   converters up to 16 bits and as 32-bit integers otherwise, so rings and
+.   log files are 4x or 2x smaller than doubles.  Each channel carries its
+.   own scale and offset:
+.
+.       volts = scale * counts + offset
+.
+.   Channel calibrations (calslope, calzero) are not applied to the counts;
+.   they are applied only when a calibrated value is needed.
+.
+*/
+
+
+#ifndef __LRAW
+#define __LRAW
+
+
+// Add some headers
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LRAW_VERSION
+Date
+Notes
+
+**1.0
+Original version.  16 and 32 bit counts with per-channel scale and offset.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LRAW_VERSION 1.0
+
+// Maximum number of channels in a sample
+#define LRAW_MAX_CH         16
+// Largest supported converter resolution
+#define LRAW_MAX_BITS       32
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    unsigned int channels;      // Number of channels per sample
+    unsigned int bits;          // Converter resolution
+    unsigned int size;          // Bytes per count; 2 or 4
+    double scale[LRAW_MAX_CH];  // Volts per count
+    double offset[LRAW_MAX_CH]; // Volts at zero counts
+} LRAW;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LRAW_INIT
+.   Configure the count format for a set of bipolar channels.  Each channel
+.   spans +/-range[ii] volts with 2**bits counts, so
+.
+.       scale = range / 2**(bits-1)
+.       offset = 0
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lraw_init(LRAW* raw, const unsigned int channels, const double* range,
+                const unsigned int bits);
+
+/* LRAW_ENCODE
+.   Convert a block of interleaved voltages to counts.  Values are rounded
+.   to the nearest count and clamped to the representable range.  counts
+.   must hold samples x channels x raw->size bytes.
+*/
+void lraw_encode(const LRAW* raw, const double* volts, void* counts,
+                const unsigned int samples);
+
+/* LRAW_DECODE
+.   Convert a block of interleaved counts back to voltages.
+*/
+void lraw_decode(const LRAW* raw, const void* counts, double* volts,
+                const unsigned int samples);
+
+/* LRAW_VOLTS
+.   Return the voltage of a single channel of a single sample in a block of
+.   counts.
+*/
+double lraw_volts(const LRAW* raw, const void* counts,
+                const unsigned int sample, const unsigned int channel);
+
+/* LRAW_WRITE_ROW
+.   Print one sample of counts as tab-separated integers and a newline.
+*/
+void lraw_write_row(const LRAW* raw, FILE* ff, const void* counts);
+
+/* LRAW_WRITE_META
+.   Write the meta parameters that describe the count format to a data file
+.   header.  LConf in lconfig.py uses these to interpret the data.
+.
+.       int:rawbits N
+.       flt:rawscaleI S
+.       flt:rawoffsetI O
+*/
+void lraw_write_meta(const LRAW* raw, FILE* ff);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+int lraw_init(LRAW* raw, const unsigned int channels, const double* range,
+                const unsigned int bits){
+    unsigned int ii;
+
+    memset(raw, 0, sizeof(LRAW));
+    if(channels == 0 || channels > LRAW_MAX_CH){
+        printf("LRAW_INIT: Channel count %u is out of range.\n", channels);
+        return 1;
+    }else if(bits < 2 || bits > LRAW_MAX_BITS){
+        printf("LRAW_INIT: Resolution %u bits is out of range.\n", bits);
+        return 1;
+    }
+    raw->channels = channels;
+    raw->bits = bits;
+    raw->size = bits <= 16 ? 2 : 4;
+    for(ii=0; ii<channels; ii++){
+        raw->scale[ii] = range[ii] / ldexp(1., bits-1);
+        raw->offset[ii] = 0.;
+    }
+    return 0;
+}
+
+//******************************************************************************
+void lraw_encode(const LRAW* raw, const double* volts, void* counts,
+                const unsigned int samples){
+    unsigned int ii, jj, kk;
+    double inv[LRAW_MAX_CH], value, cmax;
+
+    cmax = ldexp(1., 8*raw->size-1) - 1.;
+    for(jj=0; jj<raw->channels; jj++)
+        inv[jj] = 1. / raw->scale[jj];
+
+    for(ii=0, kk=0; ii<samples; ii++)
+        for(jj=0; jj<raw->channels; jj++, kk++){
+            value = nearbyint((volts[kk] - raw->offset[jj]) * inv[jj]);
+            if(value > cmax)
+                value = cmax;
+            else if(value < -cmax-1.)
+                value = -cmax-1.;
+            if(raw->size == 2)
+                ((int16_t*)counts)[kk] = (int16_t) value;
+            else
+                ((int32_t*)counts)[kk] = (int32_t) value;
+        }
+}
+
+//******************************************************************************
+void lraw_decode(const LRAW* raw, const void* counts, double* volts,
+                const unsigned int samples){
+    unsigned int ii, jj, kk;
+
+    for(ii=0, kk=0; ii<samples; ii++)
+        for(jj=0; jj<raw->channels; jj++, kk++)
+            volts[kk] = raw->scale[jj] * (raw->size == 2 ?
+                    ((const int16_t*)counts)[kk] : ((const int32_t*)counts)[kk])
+                    + raw->offset[jj];
+}
+
+//******************************************************************************
+double lraw_volts(const LRAW* raw, const void* counts,
+                const unsigned int sample, const unsigned int channel){
+    unsigned int kk;
+    kk = sample * raw->channels + channel;
+    return raw->scale[channel] * (raw->size == 2 ?
+            ((const int16_t*)counts)[kk] : ((const int32_t*)counts)[kk])
+            + raw->offset[channel];
+}
+
+//******************************************************************************
+void lraw_write_row(const LRAW* raw, FILE* ff, const void* counts){
+    unsigned int jj;
+    for(jj=0; jj<raw->channels; jj++)
+        fprintf(ff, "%ld\t", raw->size == 2 ?
+                (long)((const int16_t*)counts)[jj] : (long)((const int32_t*)counts)[jj]);
+    fputc('\n', ff);
+}
+
+//******************************************************************************
+void lraw_write_meta(const LRAW* raw, FILE* ff){
+    unsigned int jj;
+    fprintf(ff, "int:rawbits %u\n", raw->bits);
+    for(jj=0; jj<raw->channels; jj++)
+        fprintf(ff, "flt:rawscale%u %.10e\nflt:rawoffset%u %.10e\n",
+                jj, raw->scale[jj], jj, raw->offset[jj]);
+}
+
+#endif
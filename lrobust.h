@@ -0,0 +1,305 @@
+/*
+.
+.   Tools for robust estimates of noisy sample blocks
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LROBUST replaces the plain block mean with an estimate that a few large
+.   spikes (e.g. EMI from the torch) cannot drag away.  Each channel of a
+.   block is reduced to a single value by one of
+.
+.       LROB_MEAN       The plain mean (no rejection)
+.       LROB_MEDIAN     The median
+.       LROB_TRIM       The mean after discarding a fraction of the samples
+.                       from each tail
+.       LROB_MAD        The mean of the samples within k scaled median
+.                       absolute deviations of the median.  If most of
+.                       the block is one value (a MAD of zero), there is
+.                       no spread to judge by and every sample is kept.
+.
+.   Medians are found by in-place selection (quickselect) on a scratch copy,
+.   with a sorting network for the small partitions, so the cost is linear
+.   in the block size.
+.
+*/
+
+
+#ifndef __LROBUST
+#define __LROBUST
+
+
+// Add some headers
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LROB_VERSION
+Date
+Notes
+
+**1.0
+Original version.  Mean, median, trimmed mean, and MAD rejection.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LROB_VERSION 1.0
+
+// Estimator modes
+#define LROB_MEAN           0
+#define LROB_MEDIAN         1
+#define LROB_TRIM           2
+#define LROB_MAD            3
+
+// Consistency constant that scales the MAD to a standard deviation for
+// normally distributed data
+#define LROB_MAD_SCALE      1.4826
+// Default rejection threshold in scaled MADs
+#define LROB_DEF_K          3.5
+// Default trimmed fraction from each tail
+#define LROB_DEF_TRIM       0.1
+// Partitions this small are finished with a sorting network
+#define LROB_SMALL          8
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    int mode;               // LROB_MEAN, LROB_MEDIAN, LROB_TRIM, or LROB_MAD
+    double k;               // Rejection threshold in scaled MADs
+    double trim;            // Fraction trimmed from each tail
+    // Results
+    double median;          // Median of the last block
+    double mad;             // Scaled MAD of the last block
+    unsigned long accepted; // Total samples used in estimates
+    unsigned long rejected; // Total samples rejected as outliers
+} LROB;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LROB_INIT
+.   Configure an estimator.  The mode string may be "mean", "median", "trim",
+.   or "mad".  If k or trim are not positive, the defaults are used.
+.
+.   Returns 0 on success and 1 on an unrecognized mode.
+*/
+int lrob_init(LROB* rob, const char* mode, const double k, const double trim);
+
+/* LROB_ESTIMATE
+.   Reduce one channel of a block of interleaved samples to a single value.
+.
+.   data        Pointer to the first sample of the channel
+.   stride      Number of doubles between consecutive samples (the channel
+.               count for interleaved blocks)
+.   n           Number of samples
+.   work        Scratch space for at least n doubles
+.
+.   The median and scaled MAD of the block are left in rob->median and
+.   rob->mad (LROB_MEDIAN, LROB_TRIM, and LROB_MAD only) and the accepted
+.   and rejected counters are incremented.
+*/
+double lrob_estimate(LROB* rob, const double* data, const unsigned int stride,
+                const unsigned int n, double* work);
+
+/* LROB_SELECT
+.   Partially order x[0..n-1] in place so that x[k] holds the value it would
+.   have if x were sorted, every element before it is no greater, and every
+.   element after it is no smaller.  Returns x[k].
+*/
+double lrob_select(double* x, const unsigned int n, const unsigned int k);
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+#define LROB_SWAP(a,b)  do{ if(x[a] > x[b]){ t = x[a]; x[a] = x[b]; x[b] = t; } }while(0)
+
+//******************************************************************************
+// Sort up to LROB_SMALL elements with a fixed network of compare-exchanges.
+// Smaller arrays use the leading comparators that apply to them; insertion
+// cleans up any size the networks do not cover.
+static void lrob_network(double* x, const unsigned int n){
+    double t;
+    unsigned int ii, jj;
+
+    switch(n){
+    case 8:
+        LROB_SWAP(0,2); LROB_SWAP(1,3); LROB_SWAP(4,6); LROB_SWAP(5,7);
+        LROB_SWAP(0,4); LROB_SWAP(1,5); LROB_SWAP(2,6); LROB_SWAP(3,7);
+        LROB_SWAP(0,1); LROB_SWAP(2,3); LROB_SWAP(4,5); LROB_SWAP(6,7);
+        LROB_SWAP(2,4); LROB_SWAP(3,5); LROB_SWAP(1,4); LROB_SWAP(3,6);
+        LROB_SWAP(1,2); LROB_SWAP(3,4); LROB_SWAP(5,6);
+        return;
+    case 4:
+        LROB_SWAP(0,1); LROB_SWAP(2,3); LROB_SWAP(0,2); LROB_SWAP(1,3);
+        LROB_SWAP(1,2);
+        return;
+    case 3:
+        LROB_SWAP(0,1); LROB_SWAP(1,2); LROB_SWAP(0,1);
+        return;
+    case 2:
+        LROB_SWAP(0,1);
+        return;
+    }
+    // Insertion sort for the remaining small sizes
+    for(ii=1; ii<n; ii++){
+        t = x[ii];
+        for(jj=ii; jj>0 && x[jj-1] > t; jj--)
+            x[jj] = x[jj-1];
+        x[jj] = t;
+    }
+}
+
+//******************************************************************************
+double lrob_select(double* x, const unsigned int n, const unsigned int k){
+    unsigned int left, right, ii, jj, mid;
+    double pivot, t;
+
+    left = 0;
+    right = n-1;
+    while(right - left + 1 > LROB_SMALL){
+        // Median-of-three pivot; also places sentinels at the ends
+        mid = left + (right - left)/2;
+        LROB_SWAP(left, mid);
+        LROB_SWAP(mid, right);
+        LROB_SWAP(left, mid);
+        pivot = x[mid];
+
+        // Hoare partition
+        ii = left;
+        jj = right;
+        while(1){
+            while(x[++ii] < pivot);
+            while(x[--jj] > pivot);
+            if(ii >= jj)
+                break;
+            t = x[ii]; x[ii] = x[jj]; x[jj] = t;
+        }
+        // Elements [left, jj] are <= pivot and [jj+1, right] are >= pivot
+        if(k <= jj)
+            right = jj;
+        else
+            left = jj+1;
+    }
+    lrob_network(&x[left], right - left + 1);
+    return x[k];
+}
+
+#undef LROB_SWAP
+
+//******************************************************************************
+int lrob_init(LROB* rob, const char* mode, const double k, const double trim){
+    memset(rob, 0, sizeof(LROB));
+    rob->k = k > 0. ? k : LROB_DEF_K;
+    rob->trim = trim > 0. && trim < 0.5 ? trim : LROB_DEF_TRIM;
+    if(mode == NULL || strcmp(mode, "mad")==0)
+        rob->mode = LROB_MAD;
+    else if(strcmp(mode, "mean")==0)
+        rob->mode = LROB_MEAN;
+    else if(strcmp(mode, "median")==0)
+        rob->mode = LROB_MEDIAN;
+    else if(strcmp(mode, "trim")==0)
+        rob->mode = LROB_TRIM;
+    else{
+        printf("LROB_INIT: Unrecognized estimator: %s\n", mode);
+        return 1;
+    }
+    return 0;
+}
+
+//******************************************************************************
+double lrob_estimate(LROB* rob, const double* data, const unsigned int stride,
+                const unsigned int n, double* work){
+    unsigned int ii, lo, hi, count;
+    double sum, limit;
+
+    if(n == 0)
+        return NAN;
+
+    if(rob->mode == LROB_MEAN){
+        sum = 0.;
+        for(ii=0; ii<n; ii++)
+            sum += data[ii*stride];
+        rob->accepted += n;
+        return sum / n;
+    }
+
+    // Gather the channel and find its median
+    for(ii=0; ii<n; ii++)
+        work[ii] = data[ii*stride];
+    rob->median = lrob_select(work, n, n/2);
+    if(n%2 == 0)
+        // The lower middle element is the largest of the lower half
+        rob->median = 0.5*(rob->median + lrob_select(work, n/2, n/2-1));
+
+    if(rob->mode == LROB_MEDIAN){
+        rob->accepted += n;
+        return rob->median;
+    }
+
+    if(rob->mode == LROB_TRIM){
+        lo = (unsigned int)(rob->trim * n);
+        hi = n - lo;
+        // Place the order statistics at lo and hi-1; then everything between
+        // them lies inside the trimmed range
+        lrob_select(work, n, lo);
+        if(hi-1 > lo)
+            lrob_select(&work[lo+1], n-lo-1, hi-2-lo);
+        sum = 0.;
+        for(ii=lo; ii<hi; ii++)
+            sum += work[ii];
+        rob->accepted += hi - lo;
+        rob->rejected += n - (hi - lo);
+        return sum / (hi - lo);
+    }
+
+    // LROB_MAD
+    for(ii=0; ii<n; ii++)
+        work[ii] = fabs(data[ii*stride] - rob->median);
+    rob->mad = LROB_MAD_SCALE * lrob_select(work, n, n/2);
+    // With quantized data, more than half of a quiet block can sit on one
+    // count.  A zero limit would then reject every sample one count away.
+    limit = rob->mad > 0. ? rob->k * rob->mad : INFINITY;
+    sum = 0.;
+    count = 0;
+    for(ii=0; ii<n; ii++)
+        if(fabs(data[ii*stride] - rob->median) <= limit){
+            sum += data[ii*stride];
+            count++;
+        }
+    rob->accepted += count;
+    rob->rejected += n - count;
+    // If every sample was rejected (NaNs, or a k below 1), fall back on
+    // the median
+    return count ? sum / count : rob->median;
+}
+
+#endif
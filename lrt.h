@@ -0,0 +1,303 @@
+/*
+.
+.   Tools for real-time acquisition and read jitter measurement
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LRT moves the calling thread into the SCHED_FIFO real-time class, pins it
+.   to a single CPU, and locks and prefaults the process memory so that page
+.   faults and ordinary processes cannot delay the stream reads.  It also
+.   keeps the statistics needed to judge whether that worked: the intervals
+.   between successive block reads and an estimate of how many scans were
+.   waiting on the device when each block was read.
+.
+.   Real-time mode requires CAP_SYS_NICE (or root) and a sufficient
+.   RLIMIT_MEMLOCK.  A runaway SCHED_FIFO thread can starve its CPU, so the
+.   default priority is kept below the kernel's interrupt threads.
+.
+.   Only the calling thread becomes real-time, so it should do nothing but
+.   read and publish the stream; slower work belongs in threads of normal
+.   priority (see lsched.h).  The memory lock covers the whole process,
+.   including the full stack of every thread, so those threads should be
+.   created with small stacks.
+.
+.   CPU pinning uses the GNU affinity calls, so _GNU_SOURCE must be defined
+.   before the first system header is included.
+.
+*/
+
+
+#ifndef __LRT
+#define __LRT
+
+
+// Add some headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "lrobust.h"        // For percentile selection
+#include "lclock.h"         // For the monotonic clock
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LRT_VERSION
+Date
+Notes
+
+**1.0
+Original version.  SCHED_FIFO, CPU pinning, mlockall, read interval
+percentiles, and a backlog histogram.
+
+**1.1
+Read times come from lclock_now() in lclock.h.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LRT_VERSION 1.1
+
+// Default SCHED_FIFO priority; interrupt threads run at 50
+#define LRT_DEF_PRIORITY    49
+// Number of recent read intervals retained for the percentiles
+#define LRT_DEF_CAPACITY    65536
+// Bytes of stack to touch before the loop starts
+#define LRT_PREFAULT_STACK  (256*1024)
+// Backlog histogram bins; bin 0 counts no backlog and bin ii counts
+// backlogs of 2**(ii-1) up to 2**ii - 1 scans.  The last bin collects the
+// remainder.
+#define LRT_NBINS           18
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    int enabled;            // Has lrt_enter() succeeded?
+    int cpu;                // Pinned CPU or -1
+    int priority;           // SCHED_FIFO priority
+    // Read timing
+    double last;            // Monotonic time of the last block read (s)
+    double* interval;       // Ring of recent read intervals (s)
+    double* work;           // Scratch for the percentiles
+    unsigned int capacity;  // Length of interval and work
+    unsigned long reads;    // Total blocks read
+    unsigned long nint;     // Total intervals recorded
+    double maxint;          // Longest interval ever recorded (s)
+    // Backlog histogram
+    unsigned long backlog[LRT_NBINS];
+    double maxbacklog;      // Largest backlog ever estimated (scans)
+} LRT;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LRT_INIT
+.   Allocate the statistics buffers.  capacity is the number of recent
+.   intervals retained; if it is 0, LRT_DEF_CAPACITY is used.  All memory
+.   used by the LRT functions is allocated here so that none is needed once
+.   the loop is running.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lrt_init(LRT* rt, unsigned int capacity);
+
+/* LRT_ENTER
+.   Switch the calling thread to SCHED_FIFO at the given priority (or
+.   LRT_DEF_PRIORITY if priority is not positive), pin it to cpu (unless cpu
+.   is negative), lock all current and future memory, and prefault the
+.   stack.  Call this after every buffer has been allocated and before the
+.   acquisition loop.
+.
+.   Returns 0 on success and 1 on an error.  On an error, the thread is left
+.   in whatever state was reached and a message is printed.
+*/
+int lrt_enter(LRT* rt, const int cpu, const int priority);
+
+/* LRT_BLOCK
+.   Record a block read.  backlog is the number of scans the device had
+.   acquired but not yet delivered when the block was read.  It may come
+.   from the device itself or from a model of its clock; see
+.   lclock_backlog() in lclock.h.
+*/
+void lrt_block(LRT* rt, const double backlog);
+
+/* LRT_REPORT
+.   Print the read interval percentiles and the backlog histogram.
+*/
+void lrt_report(LRT* rt, FILE* ff);
+
+/* LRT_FREE
+.   Release the statistics buffers.  This does not leave real-time mode.
+*/
+void lrt_free(LRT* rt);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+int lrt_init(LRT* rt, unsigned int capacity){
+    memset(rt, 0, sizeof(LRT));
+    rt->cpu = -1;
+    rt->capacity = capacity ? capacity : LRT_DEF_CAPACITY;
+    rt->interval = malloc(rt->capacity * sizeof(double));
+    rt->work = malloc(rt->capacity * sizeof(double));
+    if(rt->interval == NULL || rt->work == NULL){
+        printf("LRT_INIT: Failed to allocate %u intervals\n", rt->capacity);
+        lrt_free(rt);
+        return 1;
+    }
+    return 0;
+}
+
+//******************************************************************************
+int lrt_enter(LRT* rt, const int cpu, const int priority){
+    struct sched_param param;
+    cpu_set_t set;
+    volatile char stack[LRT_PREFAULT_STACK];
+    unsigned int ii;
+
+    if(cpu >= 0){
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if(sched_setaffinity(0, sizeof(set), &set)){
+            printf("LRT_ENTER: Failed to pin to CPU %d: %s\n", cpu,
+                    strerror(errno));
+            return 1;
+        }
+        rt->cpu = cpu;
+    }
+
+    // Lock everything that is mapped now and everything mapped later.  This
+    // also faults in the current mappings.
+    if(mlockall(MCL_CURRENT | MCL_FUTURE)){
+        printf("LRT_ENTER: Failed to lock memory: %s\n", strerror(errno));
+        return 1;
+    }
+    // Touch the stack and the statistics buffers so their pages are
+    // resident before the first read
+    for(ii=0; ii<LRT_PREFAULT_STACK; ii+=4096)
+        stack[ii] = 0;
+    (void) stack[0];
+    memset(rt->interval, 0, rt->capacity * sizeof(double));
+    memset(rt->work, 0, rt->capacity * sizeof(double));
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority > 0 ? priority : LRT_DEF_PRIORITY;
+    if(sched_setscheduler(0, SCHED_FIFO, &param)){
+        printf("LRT_ENTER: Failed to enter SCHED_FIFO at priority %d: %s\n",
+                param.sched_priority, strerror(errno));
+        return 1;
+    }
+    rt->priority = param.sched_priority;
+    rt->enabled = 1;
+    return 0;
+}
+
+//******************************************************************************
+void lrt_block(LRT* rt, const double backlog){
+    double now, dt;
+    int bin;
+
+    if(rt->interval == NULL)
+        return;
+
+    now = lclock_now();
+    if(rt->reads){
+        dt = now - rt->last;
+        rt->interval[rt->nint % rt->capacity] = dt;
+        rt->nint++;
+        if(dt > rt->maxint)
+            rt->maxint = dt;
+    }
+    rt->last = now;
+    rt->reads++;
+
+    if(backlog < 1.)
+        bin = 0;
+    else{
+        // frexp returns the exponent e with 2**(e-1) <= backlog < 2**e
+        frexp(backlog, &bin);
+        if(bin >= LRT_NBINS)
+            bin = LRT_NBINS-1;
+    }
+    rt->backlog[bin]++;
+    if(backlog > rt->maxbacklog)
+        rt->maxbacklog = backlog;
+}
+
+//******************************************************************************
+void lrt_report(LRT* rt, FILE* ff){
+    static const double pct[] = {0.5, 0.9, 0.99, 0.999};
+    unsigned int ii, n;
+
+    fprintf(ff, "Acquisition timing (%s", rt->enabled ? "SCHED_FIFO" : "normal");
+    if(rt->enabled)
+        fprintf(ff, " priority %d, CPU %d", rt->priority, rt->cpu);
+    fprintf(ff, ")\n  Blocks read: %lu\n", rt->reads);
+
+    n = rt->nint < rt->capacity ? rt->nint : rt->capacity;
+    if(n){
+        memcpy(rt->work, rt->interval, n * sizeof(double));
+        fprintf(ff, "  Read interval (ms) over the last %u reads\n", n);
+        for(ii=0; ii<sizeof(pct)/sizeof(double); ii++)
+            fprintf(ff, "    p%-6g %10.3f\n", 100.*pct[ii],
+                    1000. * lrob_select(rt->work, n,
+                    (unsigned int)(pct[ii] * (n-1) + 0.5)));
+        fprintf(ff, "    max     %10.3f (all reads)\n", 1000. * rt->maxint);
+    }
+
+    fprintf(ff, "  Backlog at read (scans)\n");
+    for(ii=0; ii<LRT_NBINS; ii++){
+        if(rt->backlog[ii] == 0)
+            continue;
+        if(ii == 0)
+            fprintf(ff, "    %-15s %10lu\n", "0", rt->backlog[ii]);
+        else if(ii == LRT_NBINS-1)
+            fprintf(ff, "    %7lu+%7s %10lu\n", 1ul<<(ii-1), "",
+                    rt->backlog[ii]);
+        else
+            fprintf(ff, "    %7lu-%-7lu %10lu\n", 1ul<<(ii-1), (1ul<<ii)-1,
+                    rt->backlog[ii]);
+    }
+    fprintf(ff, "    max %11.0f\n", rt->maxbacklog);
+}
+
+//******************************************************************************
+void lrt_free(LRT* rt){
+    free(rt->interval);
+    free(rt->work);
+    rt->interval = rt->work = NULL;
+}
+
+#endif
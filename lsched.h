@@ -0,0 +1,325 @@
+/*
+.
+.   Tools for running a slow data source at its own rate
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LSCHED runs a function in its own thread at a fixed rate.  Each run is
+.   released on an absolute deadline (start + k * period) on the monotonic
+.   clock, so the rate does not drift with the time spent in each run.  If
+.   a run overruns one or more deadlines, those periods are skipped and
+.   counted rather than run back to back.
+.
+.   This keeps slow work (a terminal display, a polled device like the U12
+.   gas meters) from holding up a streamed acquisition loop: the loop only
+.   ever shares data under locks that are held just long enough to copy it.
+.
+.   The task thread is created with the scheduling policy of the thread
+.   that calls lsched_start(), so start it before moving the acquisition
+.   thread into real-time mode (see lrt.h).  lsched_exclude() keeps it off
+.   the CPU that the real-time thread is pinned to.  That uses the GNU
+.   affinity calls, so _GNU_SOURCE must be defined before the first system
+.   header is included.  Real-time mode locks every thread's whole stack
+.   in memory, so task threads get LSCHED_STACK bytes instead of the
+.   default (usually 8MB).
+.
+.   The task lock uses priority inheritance, so a real-time thread that
+.   waits on it lends its priority to the task.  Locks shared with the run
+.   function should do the same; see lsched_mutex_init().
+.
+*/
+
+
+#ifndef __LSCHED
+#define __LSCHED
+
+
+// Add some headers
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include "lclock.h"         // For the monotonic clock
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LSCHED_VERSION
+Date
+Notes
+
+**1.0
+Original version.
+
+**1.1
+LSCHED_RATE() changes the rate of a running task.
+
+**1.2
+Times come from lclock_now() in lclock.h.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LSCHED_VERSION 1.2
+
+#define LSCHED_MAX_STR      32
+// Slowest and fastest allowed rates (Hz)
+#define LSCHED_MIN_HZ       0.01
+#define LSCHED_MAX_HZ       1000.
+// Stack size of each task thread (bytes)
+#define LSCHED_STACK        (256*1024)
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    double period;          // Current period (s)
+    unsigned long runs;     // Completed runs
+    unsigned long fails;    // Runs that reported an error
+    unsigned long missed;   // Deadlines skipped because a run overran
+    double last;            // Monotonic time the last run started (s)
+    double lastrun;         // Duration of the last run (s)
+    double maxrun;          // Longest run (s)
+} LSCHED_STATS;
+
+typedef struct {
+    char name[LSCHED_MAX_STR];
+    int (*run)(void* arg);  // Called once per period; nonzero on an error
+    void* arg;
+    LSCHED_STATS stats;
+    pthread_mutex_t lock;   // Guards stats and stop
+    pthread_cond_t wake;    // Signaled to stop the task while it waits
+    pthread_t thread;
+    int exclude;            // CPU the thread is kept off or -1
+    int started;
+    int stop;
+} LSCHED;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LSCHED_INIT
+.   Prepare a task that calls run(arg) at hz.  The task does not run until
+.   LSCHED_START is called.
+*/
+void lsched_init(LSCHED* task, const char* name, const double hz,
+                int (*run)(void* arg), void* arg);
+
+/* LSCHED_EXCLUDE
+.   Keep the task thread off cpu (e.g. the one the real-time thread is
+.   pinned to).  A negative cpu allows every CPU.  Call this before
+.   LSCHED_START.
+*/
+void lsched_exclude(LSCHED* task, const int cpu);
+
+/* LSCHED_MUTEX_INIT
+.   Initialize a mutex with priority inheritance for sharing data between
+.   a task and a real-time thread.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lsched_mutex_init(pthread_mutex_t* lock);
+
+/* LSCHED_START
+.   Start the task thread.  The first run is released immediately.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lsched_start(LSCHED* task);
+
+/* LSCHED_RATE
+.   Change the rate.  The new period takes effect at the next deadline.
+.   Rates are clamped to LSCHED_MIN_HZ and LSCHED_MAX_HZ.
+*/
+void lsched_rate(LSCHED* task, const double hz);
+
+/* LSCHED_GET_STATS
+.   Copy the task statistics.
+*/
+void lsched_get_stats(LSCHED* task, LSCHED_STATS* stats);
+
+/* LSCHED_STOP
+.   Ask the task to stop and wait for its thread.  A run in progress is
+.   allowed to finish.
+*/
+void lsched_stop(LSCHED* task);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+static double lsched_period(const double hz){
+    if(!(hz >= LSCHED_MIN_HZ))
+        return 1./LSCHED_MIN_HZ;
+    else if(hz > LSCHED_MAX_HZ)
+        return 1./LSCHED_MAX_HZ;
+    return 1./hz;
+}
+
+//******************************************************************************
+void lsched_init(LSCHED* task, const char* name, const double hz,
+                int (*run)(void* arg), void* arg){
+    pthread_condattr_t attr;
+
+    memset(task, 0, sizeof(LSCHED));
+    strncpy(task->name, name, LSCHED_MAX_STR-1);
+    task->run = run;
+    task->arg = arg;
+    task->stats.period = lsched_period(hz);
+    task->exclude = -1;
+    lsched_mutex_init(&task->lock);
+    // Deadlines are on the monotonic clock
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&task->wake, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+//******************************************************************************
+static void* lsched_thread(void* arg){
+    LSCHED* task = arg;
+    struct timespec ts;
+    double next, start, end, period, skipped;
+    int err;
+
+    next = lclock_now();
+    pthread_mutex_lock(&task->lock);
+    while(!task->stop){
+        period = task->stats.period;
+        pthread_mutex_unlock(&task->lock);
+
+        start = lclock_now();
+        err = task->run(task->arg);
+        end = lclock_now();
+
+        // Release the next run on the next deadline that has not passed
+        next += period;
+        skipped = 0.;
+        if(next <= end){
+            skipped = floor((end - next) / period) + 1.;
+            next += skipped * period;
+        }
+
+        pthread_mutex_lock(&task->lock);
+        task->stats.runs++;
+        task->stats.fails += err != 0;
+        task->stats.missed += (unsigned long) skipped;
+        task->stats.last = start;
+        task->stats.lastrun = end - start;
+        if(end - start > task->stats.maxrun)
+            task->stats.maxrun = end - start;
+
+        // Wait for the deadline or a request to stop
+        ts.tv_sec = (time_t) next;
+        ts.tv_nsec = (long)((next - ts.tv_sec) * 1e9);
+        while(!task->stop &&
+                pthread_cond_timedwait(&task->wake, &task->lock, &ts) != ETIMEDOUT);
+    }
+    pthread_mutex_unlock(&task->lock);
+    return NULL;
+}
+
+//******************************************************************************
+void lsched_exclude(LSCHED* task, const int cpu){
+    task->exclude = cpu;
+}
+
+//******************************************************************************
+int lsched_mutex_init(pthread_mutex_t* lock){
+    pthread_mutexattr_t attr;
+    int err;
+
+    pthread_mutexattr_init(&attr);
+    err = pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT);
+    // Without priority inheritance, the lock still works
+    if(err)
+        printf("LSCHED_MUTEX_INIT: No priority inheritance: %s\n",
+                strerror(err));
+    pthread_mutex_init(lock, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return err != 0;
+}
+
+//******************************************************************************
+int lsched_start(LSCHED* task){
+    pthread_attr_t attr;
+    cpu_set_t cpus;
+    int err;
+
+    task->stop = 0;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, LSCHED_STACK);
+    // Every CPU this thread may use except the excluded one
+    if(task->exclude >= 0 && task->exclude < CPU_SETSIZE &&
+            !sched_getaffinity(0, sizeof(cpus), &cpus)){
+        CPU_CLR(task->exclude, &cpus);
+        if(CPU_COUNT(&cpus))
+            pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+    }
+    err = pthread_create(&task->thread, &attr, lsched_thread, task);
+    pthread_attr_destroy(&attr);
+    if(err){
+        printf("LSCHED_START: Failed to start the %s task: %s\n", task->name,
+                strerror(err));
+        return 1;
+    }
+    task->started = 1;
+    return 0;
+}
+
+//******************************************************************************
+void lsched_rate(LSCHED* task, const double hz){
+    pthread_mutex_lock(&task->lock);
+    task->stats.period = lsched_period(hz);
+    pthread_mutex_unlock(&task->lock);
+}
+
+//******************************************************************************
+void lsched_get_stats(LSCHED* task, LSCHED_STATS* stats){
+    pthread_mutex_lock(&task->lock);
+    *stats = task->stats;
+    pthread_mutex_unlock(&task->lock);
+}
+
+//******************************************************************************
+void lsched_stop(LSCHED* task){
+    if(!task->started)
+        return;
+    pthread_mutex_lock(&task->lock);
+    task->stop = 1;
+    pthread_cond_signal(&task->wake);
+    pthread_mutex_unlock(&task->lock);
+    pthread_join(task->thread, NULL);
+    task->started = 0;
+}
+
+#endif
@@ -0,0 +1,599 @@
+/*
+.
+.   Tools for streaming live measurements to local client processes
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LSERVE publishes blocks of samples and derived values over a Unix domain
+.   socket and (optionally) a TCP socket bound to localhost.  Acquisition
+.   never waits on a client; clients that cannot keep up are decimated and
+.   eventually dropped.  A frame is only sent when the client's socket
+.   buffer has room for all of it, so a slow client misses whole frames
+.   rather than receiving part of one.
+.
+*/
+
+
+#ifndef __LSERVE
+#define __LSERVE
+
+
+// Add some headers
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#ifdef __linux__
+#include <linux/sockios.h>
+#endif
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LSERVE_VERSION
+Date
+Notes
+
+**1.0
+Original version.  Unix and localhost TCP listeners, binary block framing,
+per-client decimation, and scatter-gather sends from the caller's buffers.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LSERVE_VERSION 1.0
+
+// Maximum number of simultaneous subscribers
+#define LSERVE_MAX_CLIENTS  8
+// Maximum number of named derived values
+#define LSERVE_MAX_VALUES   32
+#define LSERVE_MAX_STR      32
+// Maximum number of sample channels described in the calibration frame
+#define LSERVE_MAX_CH       16
+// Number of consecutive frames a client may miss before its decimation is
+// doubled.  Once the decimation reaches LSERVE_MAX_DECIMATE, the client is
+// dropped instead.
+#define LSERVE_MISS_LIMIT   4
+#define LSERVE_MAX_DECIMATE 1024
+// Largest scatter-gather list used for a single frame
+#ifdef IOV_MAX
+#define LSERVE_IOV_MAX      IOV_MAX
+#else
+#define LSERVE_IOV_MAX      1024
+#endif
+
+/*
+.   Frame format
+.
+.   Every message starts with a 40-byte LSERVE_FRAME header in host byte order
+.   followed by a payload of 8-byte doubles.
+.
+.   magic       Always LSERVE_MAGIC ("LSRV" on little-endian hosts)
+.   version     LSERVE_FRAME_VERSION
+.   type        One of the LSERVE_TYPE_XXX values below
+.   sequence    Per-client frame counter; gaps indicate dropped frames
+.   channels    Number of values per sample
+.   samples     Number of samples in the payload
+.   decimate    The decimation applied to this client's block frames
+.   index       Stream index of the first sample in the payload
+.   time        Host CLOCK_REALTIME when the frame was published (s)
+.
+.   LSERVE_TYPE_BLOCK   channels x samples doubles; sample-major (interleaved)
+.                       raw voltages exactly as read from the device
+.   LSERVE_TYPE_CAL     channels x 2 doubles; (slope, zero) per channel so
+.                       that calibrated = slope * (raw - zero)
+.   LSERVE_TYPE_VALUES  channels doubles; one sample of derived values
+.   LSERVE_TYPE_NAMES   channels x LSERVE_MAX_STR characters; zero-padded
+.                       names of the derived values
+.
+.   Clients may write a single uint32_t at any time to request a decimation;
+.   only every decimate-th sample of each block will be sent to them.
+*/
+#define LSERVE_MAGIC        0x5652534C
+#define LSERVE_FRAME_VERSION 1
+#define LSERVE_TYPE_BLOCK   1
+#define LSERVE_TYPE_CAL     2
+#define LSERVE_TYPE_VALUES  3
+#define LSERVE_TYPE_NAMES   4
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t type;
+    uint32_t sequence;
+    uint32_t channels;
+    uint32_t samples;
+    uint32_t decimate;
+    uint64_t index;
+    double   time;
+} LSERVE_FRAME;
+
+
+typedef struct {
+    int fd;                 // Socket file descriptor; -1 when unused
+    uint32_t decimate;      // Send every decimate-th sample
+    uint32_t sequence;      // Next frame sequence number
+    int sndbuf;             // Socket send buffer size (bytes)
+    unsigned int missed;    // Consecutive frames missed
+    unsigned long dropped;  // Total frames not delivered
+} LSERVE_CLIENT;
+
+
+typedef struct {
+    int unix_fd;            // Unix domain listener; -1 if disabled
+    int tcp_fd;             // Localhost TCP listener; -1 if disabled
+    char path[sizeof(((struct sockaddr_un*)0)->sun_path)];
+    LSERVE_CLIENT client[LSERVE_MAX_CLIENTS];
+    uint64_t index;         // Running stream sample index
+    // Calibration and naming information sent to each new client
+    unsigned int nch;
+    double cal[2*LSERVE_MAX_CH];
+    unsigned int nvalues;
+    char names[LSERVE_MAX_VALUES][LSERVE_MAX_STR];
+} LSERVE;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LSERVE_OPEN
+.   Initialize the server and open its listening sockets.  If path is not NULL
+.   or empty, a Unix domain socket is created at that path (an existing socket
+.   file is replaced).  If port is nonzero, a TCP socket is bound to 127.0.0.1
+.   on that port.  All sockets are non-blocking.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lserve_open(LSERVE* server, const char* path, const unsigned int port);
+
+/* LSERVE_CLOSE
+.   Disconnect all clients, close the listeners, and remove the socket file.
+*/
+void lserve_close(LSERVE* server);
+
+/* LSERVE_SET_CAL
+.   Record the per-channel calibration (slope, zero) that will be sent to each
+.   client when it connects and to all current clients immediately.
+*/
+void lserve_set_cal(LSERVE* server, const unsigned int nch,
+                const double* slope, const double* zero);
+
+/* LSERVE_SET_NAMES
+.   Record the names of the derived values published by LSERVE_SEND_VALUES.
+*/
+void lserve_set_names(LSERVE* server, const unsigned int nvalues,
+                const char* names[]);
+
+/* LSERVE_SERVICE
+.   Accept new connections and read decimation requests from current clients.
+.   This never blocks, and it should be called once per acquisition loop.
+.
+.   Returns the number of connected clients.
+*/
+int lserve_service(LSERVE* server);
+
+/* LSERVE_SEND_BLOCK
+.   Publish a block of interleaved samples to every client.  The data are sent
+.   directly from the caller's buffer with scatter-gather I/O; no copies are
+.   made.  Decimated clients receive a list of pointers to the rows they
+.   requested.  The server's stream index is advanced by samples.
+*/
+void lserve_send_block(LSERVE* server, const double* data,
+                const unsigned int channels, const unsigned int samples);
+
+/* LSERVE_SEND_VALUES
+.   Publish a single sample of derived values to every client.
+*/
+void lserve_send_values(LSERVE* server, const double* values,
+                const unsigned int nvalues);
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+static int lserve_nonblock(int fd){
+    int flags;
+    flags = fcntl(fd, F_GETFL, 0);
+    if(flags < 0)
+        return 1;
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0;
+}
+
+//******************************************************************************
+static double lserve_now(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+//******************************************************************************
+static void lserve_drop(LSERVE_CLIENT* client){
+    if(client->fd >= 0)
+        close(client->fd);
+    client->fd = -1;
+}
+
+//******************************************************************************
+// Count a frame the client could not take.  A client that keeps missing
+// frames gets fewer samples.
+static void lserve_miss(LSERVE_CLIENT* client){
+    client->dropped++;
+    client->missed++;
+    if(client->missed >= LSERVE_MISS_LIMIT){
+        client->missed = 0;
+        if(client->decimate >= LSERVE_MAX_DECIMATE)
+            lserve_drop(client);
+        else
+            client->decimate *= 2;
+    }
+}
+
+//******************************************************************************
+// Is there room in the client's send buffer for a whole frame of total
+// bytes?  Linux doubles SO_SNDBUF to allow for its own bookkeeping, so half
+// of it is the data that fits; the buffer is grown once for frames larger
+// than that.  Without SIOCOUTQ, the send itself is the only test.
+static int lserve_room(LSERVE_CLIENT* client, const size_t total){
+#ifdef SIOCOUTQ
+    socklen_t length;
+    int queued, size;
+
+    if(total > (size_t) client->sndbuf / 2 && total < INT_MAX/2){
+        size = (int) total;
+        length = sizeof(client->sndbuf);
+        setsockopt(client->fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+        getsockopt(client->fd, SOL_SOCKET, SO_SNDBUF, &client->sndbuf, &length);
+    }
+    if(ioctl(client->fd, SIOCOUTQ, &queued))
+        return 1;
+    return (size_t) queued + total <= (size_t) client->sndbuf / 2;
+#else
+    return 1;
+#endif
+}
+
+//******************************************************************************
+// Send a single frame to a client.  The frame is either delivered whole or not
+// at all: it is only sent if the socket buffer has room for it.  A partial
+// write can then only come from a buffer that shrank under us, and since it
+// leaves the stream framing corrupt, the client is disconnected.  Returns 0
+// if the frame was sent.
+static int lserve_sendv(LSERVE_CLIENT* client, struct iovec* iov, int niov){
+    struct msghdr msg;
+    ssize_t sent;
+    size_t total;
+    int ii;
+
+    total = 0;
+    for(ii=0; ii<niov; ii++)
+        total += iov[ii].iov_len;
+
+    if(!lserve_room(client, total)){
+        lserve_miss(client);
+        return 1;
+    }
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = niov;
+    sent = sendmsg(client->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if(sent == (ssize_t) total){
+        client->missed = 0;
+        client->sequence++;
+        return 0;
+    }else if(sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)){
+        lserve_miss(client);
+        return 1;
+    }
+    // Partial writes and hard errors both end the connection
+    lserve_drop(client);
+    return 1;
+}
+
+//******************************************************************************
+static void lserve_header(LSERVE_FRAME* frame, const LSERVE_CLIENT* client,
+                const uint16_t type, const uint32_t channels,
+                const uint32_t samples, const uint64_t index, const double time){
+    frame->magic = LSERVE_MAGIC;
+    frame->version = LSERVE_FRAME_VERSION;
+    frame->type = type;
+    frame->sequence = client->sequence;
+    frame->channels = channels;
+    frame->samples = samples;
+    frame->decimate = client->decimate;
+    frame->index = index;
+    frame->time = time;
+}
+
+//******************************************************************************
+static void lserve_send_info(LSERVE* server, LSERVE_CLIENT* client){
+    LSERVE_FRAME frame;
+    struct iovec iov[2];
+    double time;
+
+    time = lserve_now();
+    if(server->nch && client->fd >= 0){
+        lserve_header(&frame, client, LSERVE_TYPE_CAL, server->nch, 2,
+                server->index, time);
+        iov[0].iov_base = &frame;
+        iov[0].iov_len = sizeof(frame);
+        iov[1].iov_base = server->cal;
+        iov[1].iov_len = 2*server->nch*sizeof(double);
+        lserve_sendv(client, iov, 2);
+    }
+    if(server->nvalues && client->fd >= 0){
+        lserve_header(&frame, client, LSERVE_TYPE_NAMES, server->nvalues, 1,
+                server->index, time);
+        iov[0].iov_base = &frame;
+        iov[0].iov_len = sizeof(frame);
+        iov[1].iov_base = server->names;
+        iov[1].iov_len = server->nvalues*LSERVE_MAX_STR;
+        lserve_sendv(client, iov, 2);
+    }
+}
+
+//******************************************************************************
+int lserve_open(LSERVE* server, const char* path, const unsigned int port){
+    struct sockaddr_un uaddr;
+    struct sockaddr_in iaddr;
+    int ii, on = 1;
+
+    memset(server, 0, sizeof(LSERVE));
+    server->unix_fd = -1;
+    server->tcp_fd = -1;
+    for(ii=0; ii<LSERVE_MAX_CLIENTS; ii++)
+        server->client[ii].fd = -1;
+
+    if(path && path[0]){
+        if(strlen(path) >= sizeof(uaddr.sun_path)){
+            printf("LSERVE_OPEN: Socket path is too long: %s\n", path);
+            return 1;
+        }
+        strcpy(server->path, path);
+        memset(&uaddr, 0, sizeof(uaddr));
+        uaddr.sun_family = AF_UNIX;
+        strcpy(uaddr.sun_path, path);
+        unlink(path);
+        server->unix_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(server->unix_fd < 0 ||
+                bind(server->unix_fd, (struct sockaddr*) &uaddr, sizeof(uaddr)) ||
+                listen(server->unix_fd, LSERVE_MAX_CLIENTS) ||
+                lserve_nonblock(server->unix_fd)){
+            printf("LSERVE_OPEN: Failed to open socket %s: %s\n",
+                    path, strerror(errno));
+            lserve_close(server);
+            return 1;
+        }
+    }
+
+    if(port){
+        memset(&iaddr, 0, sizeof(iaddr));
+        iaddr.sin_family = AF_INET;
+        iaddr.sin_port = htons(port);
+        iaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        server->tcp_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(server->tcp_fd >= 0)
+            setsockopt(server->tcp_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if(server->tcp_fd < 0 ||
+                bind(server->tcp_fd, (struct sockaddr*) &iaddr, sizeof(iaddr)) ||
+                listen(server->tcp_fd, LSERVE_MAX_CLIENTS) ||
+                lserve_nonblock(server->tcp_fd)){
+            printf("LSERVE_OPEN: Failed to open localhost port %u: %s\n",
+                    port, strerror(errno));
+            lserve_close(server);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//******************************************************************************
+void lserve_close(LSERVE* server){
+    int ii;
+    for(ii=0; ii<LSERVE_MAX_CLIENTS; ii++)
+        lserve_drop(&server->client[ii]);
+    if(server->unix_fd >= 0){
+        close(server->unix_fd);
+        unlink(server->path);
+    }
+    if(server->tcp_fd >= 0)
+        close(server->tcp_fd);
+    server->unix_fd = -1;
+    server->tcp_fd = -1;
+}
+
+//******************************************************************************
+void lserve_set_cal(LSERVE* server, const unsigned int nch,
+                const double* slope, const double* zero){
+    unsigned int ii;
+    server->nch = nch < LSERVE_MAX_CH ? nch : LSERVE_MAX_CH;
+    for(ii=0; ii<server->nch; ii++){
+        server->cal[2*ii] = slope[ii];
+        server->cal[2*ii+1] = zero[ii];
+    }
+    for(ii=0; ii<LSERVE_MAX_CLIENTS; ii++)
+        if(server->client[ii].fd >= 0)
+            lserve_send_info(server, &server->client[ii]);
+}
+
+//******************************************************************************
+void lserve_set_names(LSERVE* server, const unsigned int nvalues,
+                const char* names[]){
+    unsigned int ii;
+    server->nvalues = nvalues < LSERVE_MAX_VALUES ? nvalues : LSERVE_MAX_VALUES;
+    memset(server->names, 0, sizeof(server->names));
+    for(ii=0; ii<server->nvalues; ii++)
+        strncpy(server->names[ii], names[ii], LSERVE_MAX_STR-1);
+}
+
+//******************************************************************************
+int lserve_service(LSERVE* server){
+    int ii, fd, count, listener[2];
+    uint32_t request;
+    ssize_t nread;
+    socklen_t length;
+    LSERVE_CLIENT* client;
+
+    // Accept any new connections
+    listener[0] = server->unix_fd;
+    listener[1] = server->tcp_fd;
+    for(ii=0; ii<2; ii++){
+        if(listener[ii] < 0)
+            continue;
+        while((fd = accept(listener[ii], NULL, NULL)) >= 0){
+            client = NULL;
+            for(count=0; count<LSERVE_MAX_CLIENTS; count++)
+                if(server->client[count].fd < 0){
+                    client = &server->client[count];
+                    break;
+                }
+            if(client == NULL || lserve_nonblock(fd)){
+                close(fd);
+                continue;
+            }
+            memset(client, 0, sizeof(LSERVE_CLIENT));
+            client->fd = fd;
+            client->decimate = 1;
+            length = sizeof(client->sndbuf);
+            getsockopt(fd, SOL_SOCKET, SO_SNDBUF, &client->sndbuf, &length);
+            lserve_send_info(server, client);
+        }
+    }
+
+    // Check for decimation requests and hang-ups
+    count = 0;
+    for(ii=0; ii<LSERVE_MAX_CLIENTS; ii++){
+        client = &server->client[ii];
+        if(client->fd < 0)
+            continue;
+        while((nread = recv(client->fd, &request, sizeof(request), MSG_DONTWAIT))
+                == sizeof(request))
+            client->decimate = request < 1 ? 1 :
+                    (request > LSERVE_MAX_DECIMATE ? LSERVE_MAX_DECIMATE : request);
+        if(nread == 0 || (nread < 0 && errno != EAGAIN && errno != EWOULDBLOCK)){
+            lserve_drop(client);
+            continue;
+        }
+        count++;
+    }
+    return count;
+}
+
+//******************************************************************************
+void lserve_send_block(LSERVE* server, const double* data,
+                const unsigned int channels, const unsigned int samples){
+    // 16 kB of stack at most; the real-time thread prefaults more (lrt.h)
+    struct iovec iov[LSERVE_IOV_MAX];
+    LSERVE_FRAME frame;
+    LSERVE_CLIENT* client;
+    unsigned int ii, row, first, rows;
+    size_t rowlen;
+    double time;
+    int niov;
+
+    time = lserve_now();
+    rowlen = channels * sizeof(double);
+    for(ii=0; ii<LSERVE_MAX_CLIENTS; ii++){
+        client = &server->client[ii];
+        if(client->fd < 0)
+            continue;
+        // Undecimated clients get the whole block in one contiguous piece
+        if(client->decimate <= 1){
+            lserve_header(&frame, client, LSERVE_TYPE_BLOCK, channels, samples,
+                    server->index, time);
+            iov[0].iov_base = &frame;
+            iov[0].iov_len = sizeof(frame);
+            iov[1].iov_base = (void*) data;
+            iov[1].iov_len = samples * rowlen;
+            lserve_sendv(client, iov, 2);
+            continue;
+        }
+        // Decimated clients get one iovec per retained row.  Keep the
+        // retained rows aligned to the stream index so the decimation is
+        // seamless across blocks.
+        first = (client->decimate - server->index % client->decimate)
+                % client->decimate;
+        row = first;
+        while(row < samples && client->fd >= 0){
+            niov = 1;
+            rows = 0;
+            first = row;
+            for(; row < samples && niov < LSERVE_IOV_MAX; row += client->decimate){
+                iov[niov].iov_base = (void*) &data[row*channels];
+                iov[niov].iov_len = rowlen;
+                niov++;
+                rows++;
+            }
+            lserve_header(&frame, client, LSERVE_TYPE_BLOCK, channels, rows,
+                    server->index + first, time);
+            iov[0].iov_base = &frame;
+            iov[0].iov_len = sizeof(frame);
+            if(lserve_sendv(client, iov, niov))
+                break;
+        }
+    }
+    server->index += samples;
+}
+
+//******************************************************************************
+void lserve_send_values(LSERVE* server, const double* values,
+                const unsigned int nvalues){
+    LSERVE_FRAME frame;
+    struct iovec iov[2];
+    double time;
+    int ii;
+
+    time = lserve_now();
+    for(ii=0; ii<LSERVE_MAX_CLIENTS; ii++){
+        if(server->client[ii].fd < 0)
+            continue;
+        lserve_header(&frame, &server->client[ii], LSERVE_TYPE_VALUES,
+                nvalues, 1, server->index, time);
+        iov[0].iov_base = &frame;
+        iov[0].iov_len = sizeof(frame);
+        iov[1].iov_base = (void*) values;
+        iov[1].iov_len = nvalues * sizeof(double);
+        lserve_sendv(&server->client[ii], iov, 2);
+    }
+}
+
+#endif
@@ -0,0 +1,390 @@
+/*
+.
+.   Tools for publishing live samples in a shared memory ring
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LSHM maintains a single-producer/multi-consumer ring of raw and calibrated
+.   samples in POSIX shared memory (/dev/shm/<name>).  Readers map the
+.   segment and view it directly; see py/lshm.py for a numpy reader.  Readers
+.   never signal the producer, so any number of them add no load to the
+.   acquisition.
+.
+*/
+
+
+#ifndef __LSHM
+#define __LSHM
+
+
+// Add some headers
+#include <unistd.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lraw.h"
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LSHM_VERSION
+Date
+Notes
+
+**1.0
+Original version.  Mirrored float64 raw, calibrated, and timestamp rings.
+
+**1.1
+Optional raw count rings (layout 2) with deferred calibration.
+
+**1.2
+LSHM_UPDATE changes the sample rate and calibrations of an open ring.
+
+**1.3
+LSHM_WRITE_AT stamps a block from the device sample clock (see lclock.h).
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LSHM_VERSION 1.3
+
+#define LSHM_MAGIC          "LSHMRING"
+#define LSHM_LAYOUT         2
+#define LSHM_HEADER_SIZE    1024
+#define LSHM_MAX_CH         16
+#define LSHM_MAX_STR        64
+
+// Data type codes for the raw ring
+#define LSHM_FLOAT64        0
+#define LSHM_INT16          1
+#define LSHM_INT32          2
+
+/*
+.   Segment layout
+.
+.   The segment begins with a LSHM_HEADER_SIZE byte header (LSHM_HEADER).  All
+.   values are in host byte order.  It is followed by three rings, each with
+.   2 x capacity rows.
+.
+.       raw     capacity x 2 x channels dtype      Volts or counts as read
+.       cal     capacity x 2 x channels float64    slope * (volts - zero)
+.       time    capacity x 2 float64               CLOCK_REALTIME (s)
+.
+.   When the ring is opened with a raw count format (see lraw.h), dtype is
+.   LSHM_INT16 or LSHM_INT32, the raw ring holds counts, and there is no
+.   calibrated ring (cal_offset is 0).  Readers calibrate lazily with
+.
+.       volts = rawscale * counts + rawoffset
+.
+.   Every sample is written twice: once in row (n % capacity) and again in
+.   row (n % capacity) + capacity.  As a result, the most recent N <= capacity
+.   samples are always contiguous, starting at row
+.
+.       (write_index - N) % capacity
+.
+.   so readers can take a view of them without stitching or copying.
+.
+.   write_index is the total number of samples ever written.  It is updated
+.   with release semantics only after the sample data are in place.  Before
+.   a block is copied in, write_pending is set to the write_index the block
+.   will produce, so its rows are claimed before any of them are
+.   overwritten.  A reader that holds a view of samples starting at index n
+.   may trust its contents as long as
+.
+.       write_pending - n <= capacity
+.
+.   after it has finished with them.  Testing write_index instead is not
+.   enough: the oldest rows in the view may be the ones being overwritten
+.   by the block in progress.
+*/
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    char magic[8];          // LSHM_MAGIC
+    uint32_t layout;        // LSHM_LAYOUT
+    uint32_t header_size;   // LSHM_HEADER_SIZE
+    uint32_t channels;      // Number of channels per sample
+    uint32_t dtype;         // LSHM_FLOAT64, LSHM_INT16, or LSHM_INT32
+    uint64_t capacity;      // Number of samples retained
+    uint64_t write_index;   // Total samples written
+    double samplehz;        // Nominal sample rate
+    uint64_t raw_offset;    // Byte offset of the raw ring
+    uint64_t cal_offset;    // Byte offset of the calibrated ring
+    uint64_t time_offset;   // Byte offset of the timestamp ring
+    double slope[LSHM_MAX_CH];
+    double zero[LSHM_MAX_CH];
+    uint32_t rawbits;       // Converter resolution; 0 if not raw
+    uint32_t rawsize;       // Bytes per raw value
+    double rawscale[LSHM_MAX_CH];
+    double rawoffset[LSHM_MAX_CH];
+    uint64_t write_pending; // write_index once the block in progress is in
+} LSHM_HEADER;
+
+
+typedef struct {
+    char name[LSHM_MAX_STR];
+    LSHM_HEADER* header;    // Start of the mapped segment
+    LRAW format;            // Raw count format if format.size is nonzero
+    char* raw;
+    double* cal;            // NULL for raw count rings
+    double* time;
+    size_t size;            // Total segment size in bytes
+} LSHM;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LSHM_OPEN
+.   Create (or replace) the shared memory segment /name and initialize its
+.   header.
+.
+.   name        Segment name without the leading slash
+.   channels    Number of channels per sample
+.   capacity    Number of samples retained in the ring
+.   samplehz    Nominal sample rate recorded in the header
+.   slope, zero Per-channel calibrations; may be NULL for the identity
+.   raw         Raw count format; if NULL, voltages and calibrated values
+.               are stored as doubles.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lshm_open(LSHM* ring, const char* name, const unsigned int channels,
+                const unsigned int capacity, const double samplehz,
+                const double* slope, const double* zero, const LRAW* raw);
+
+/* LSHM_WRITE
+.   Append a block of interleaved samples to the ring.  The last sample in the
+.   block is stamped with the current time, and earlier samples are stamped
+.   backwards at the nominal sample rate.
+*/
+void lshm_write(LSHM* ring, const double* data, const unsigned int samples);
+
+/* LSHM_WRITE_AT
+.   Append a block like LSHM_WRITE, but stamp sample ii with
+.   first + ii * period, where first is the CLOCK_REALTIME at which the
+.   first sample was taken (e.g. from lclock_wall()).
+*/
+void lshm_write_at(LSHM* ring, const double* data, const unsigned int samples,
+                const double first, const double period);
+
+/* LSHM_UPDATE
+.   Change the nominal sample rate and the per-channel calibrations recorded
+.   in the header of an open ring.  Calibrated values already in the ring
+.   are not changed.  slope and zero may be NULL for the identity.
+*/
+void lshm_update(LSHM* ring, const double samplehz, const double* slope,
+                const double* zero);
+
+/* LSHM_CLOSE
+.   Unmap and remove the shared memory segment.
+*/
+void lshm_close(LSHM* ring);
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+int lshm_open(LSHM* ring, const char* name, const unsigned int channels,
+                const unsigned int capacity, const double samplehz,
+                const double* slope, const double* zero, const LRAW* raw){
+    char path[LSHM_MAX_STR+1];
+    size_t rowsize, rawsize;
+    unsigned int ii;
+    int fd;
+    void* base;
+
+    memset(ring, 0, sizeof(LSHM));
+    if(channels == 0 || channels > LSHM_MAX_CH || capacity == 0){
+        printf("LSHM_OPEN: Invalid ring shape %u x %u\n", capacity, channels);
+        return 1;
+    }else if(strlen(name) >= LSHM_MAX_STR){
+        printf("LSHM_OPEN: Segment name is too long: %s\n", name);
+        return 1;
+    }else if(raw && raw->channels != channels){
+        printf("LSHM_OPEN: Raw format has %u channels; expected %u\n",
+                raw->channels, channels);
+        return 1;
+    }
+
+    // Raw count rings defer calibration and have no calibrated ring
+    rowsize = channels * sizeof(double);
+    if(raw){
+        ring->format = *raw;
+        rawsize = channels * raw->size;
+        // Leave room to align the timestamps on an 8-byte boundary
+        ring->size = LSHM_HEADER_SIZE + 2*capacity*(rawsize + sizeof(double)) + 8;
+    }else{
+        rawsize = rowsize;
+        ring->size = LSHM_HEADER_SIZE + 2*capacity*(2*rowsize + sizeof(double));
+    }
+
+    sprintf(path, "/%s", name);
+    fd = shm_open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if(fd < 0 || ftruncate(fd, ring->size)){
+        printf("LSHM_OPEN: Failed to create %s: %s\n", path, strerror(errno));
+        if(fd >= 0)
+            close(fd);
+        return 1;
+    }
+    base = mmap(NULL, ring->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(base == MAP_FAILED){
+        printf("LSHM_OPEN: Failed to map %s: %s\n", path, strerror(errno));
+        shm_unlink(path);
+        return 1;
+    }
+    strcpy(ring->name, path);
+
+    ring->header = (LSHM_HEADER*) base;
+    memset(ring->header, 0, LSHM_HEADER_SIZE);
+    ring->header->layout = LSHM_LAYOUT;
+    ring->header->header_size = LSHM_HEADER_SIZE;
+    ring->header->channels = channels;
+    ring->header->dtype = raw ? (raw->size == 2 ? LSHM_INT16 : LSHM_INT32) :
+            LSHM_FLOAT64;
+    ring->header->capacity = capacity;
+    ring->header->samplehz = samplehz;
+    ring->header->raw_offset = LSHM_HEADER_SIZE;
+    if(raw){
+        ring->header->cal_offset = 0;
+        ring->header->time_offset =
+                (ring->header->raw_offset + 2*capacity*rawsize + 7) & ~(uint64_t)7;
+        ring->header->rawbits = raw->bits;
+        ring->header->rawsize = raw->size;
+    }else{
+        ring->header->cal_offset = ring->header->raw_offset + 2*capacity*rawsize;
+        ring->header->time_offset = ring->header->cal_offset + 2*capacity*rowsize;
+        ring->header->rawsize = sizeof(double);
+    }
+    for(ii=0; ii<channels; ii++){
+        ring->header->slope[ii] = slope ? slope[ii] : 1.;
+        ring->header->zero[ii] = zero ? zero[ii] : 0.;
+        ring->header->rawscale[ii] = raw ? raw->scale[ii] : 1.;
+        ring->header->rawoffset[ii] = raw ? raw->offset[ii] : 0.;
+    }
+    ring->raw = (char*)base + ring->header->raw_offset;
+    ring->cal = raw ? NULL : (double*)((char*)base + ring->header->cal_offset);
+    ring->time = (double*)((char*)base + ring->header->time_offset);
+    // Write the magic number last so readers never see a partial header
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(ring->header->magic, LSHM_MAGIC, 8);
+    return 0;
+}
+
+//******************************************************************************
+void lshm_write(LSHM* ring, const double* data, const unsigned int samples){
+    struct timespec ts;
+    double now, dt;
+
+    if(ring->header == NULL)
+        return;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    now = ts.tv_sec + 1e-9*ts.tv_nsec;
+    dt = ring->header->samplehz > 0. ? 1./ring->header->samplehz : 0.;
+    lshm_write_at(ring, data, samples, now - (samples - 1.) * dt, dt);
+}
+
+//******************************************************************************
+void lshm_write_at(LSHM* ring, const double* data, const unsigned int samples,
+                const double first, const double period){
+    uint64_t index, capacity, slot;
+    unsigned int ii, jj, channels;
+    size_t rawsize;
+    double value;
+    double *raw, *cal;
+
+    if(ring->header == NULL)
+        return;
+
+    channels = ring->header->channels;
+    capacity = ring->header->capacity;
+    index = ring->header->write_index;
+    rawsize = channels * ring->format.size;
+    // Claim the rows before overwriting them; the full barrier keeps the
+    // data stores below from being seen before the claim
+    __atomic_store_n(&ring->header->write_pending, index + samples,
+            __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    for(ii=0; ii<samples; ii++, index++){
+        slot = index % capacity;
+        ring->time[slot] = ring->time[slot + capacity] = first + ii * period;
+        // Raw count rings store the counts only; calibration is deferred
+        if(ring->format.size){
+            lraw_encode(&ring->format, &data[ii*channels],
+                    &ring->raw[slot*rawsize], 1);
+            memcpy(&ring->raw[(slot + capacity)*rawsize],
+                    &ring->raw[slot*rawsize], rawsize);
+            continue;
+        }
+        raw = &((double*)ring->raw)[slot*channels];
+        cal = &ring->cal[slot*channels];
+        for(jj=0; jj<channels; jj++){
+            value = data[ii*channels + jj];
+            raw[jj] = value;
+            raw[jj + capacity*channels] = value;
+            value = ring->header->slope[jj] * (value - ring->header->zero[jj]);
+            cal[jj] = value;
+            cal[jj + capacity*channels] = value;
+        }
+    }
+    // Publish the new samples
+    __atomic_store_n(&ring->header->write_index, index, __ATOMIC_RELEASE);
+}
+
+//******************************************************************************
+void lshm_update(LSHM* ring, const double samplehz, const double* slope,
+                const double* zero){
+    unsigned int ii;
+
+    if(ring->header == NULL)
+        return;
+    ring->header->samplehz = samplehz;
+    for(ii=0; ii<ring->header->channels; ii++){
+        ring->header->slope[ii] = slope ? slope[ii] : 1.;
+        ring->header->zero[ii] = zero ? zero[ii] : 0.;
+    }
+}
+
+//******************************************************************************
+void lshm_close(LSHM* ring){
+    if(ring->header == NULL)
+        return;
+    munmap(ring->header, ring->size);
+    shm_unlink(ring->name);
+    ring->header = NULL;
+}
+
+#endif
@@ -0,0 +1,433 @@
+/*
+.
+.   Tools for streaming summary statistics and quantile sketches
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LSTAT keeps the summary of a stream of values in fixed memory: the
+.   count, mean, and variance (Welford's method), the extrema, and a KLL
+.   quantile sketch for percentiles.  Values can be added one at a time or
+.   a block at a time, and two summaries can be merged, so per-block,
+.   per-file, and whole-campaign statistics all come from the same
+.   structure without keeping the data.
+.
+.   The sketch keeps a hierarchy of compactors.  Level h holds items that
+.   each stand for 2**h values.  When a level reaches its capacity, it is
+.   sorted and every other item (starting at random) is promoted to the
+.   next level.  Capacities shrink by 2/3 per level below the top, so the
+.   memory stays near 3*LSTAT_K items no matter how many values are added.
+.   The rank error is typically well under 1% of the count for
+.   LSTAT_K = 128.  The levels are stored contiguously in one array, with
+.   level 0 at the low end growing down into the free space.
+.
+.   Summaries are saved as one line of text (see lstat_write()) so that they
+.   can be kept next to data files and merged later.
+.
+*/
+
+
+#ifndef __LSTAT
+#define __LSTAT
+
+
+// Add some headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LSTAT_VERSION
+Date
+Notes
+
+**1.0
+Original version.  Welford moments and a KLL quantile sketch.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LSTAT_VERSION 1.0
+
+#define LSTAT_K         128     // Capacity of the top level
+#define LSTAT_MINCAP    8       // Smallest capacity of any level
+#define LSTAT_LEVELS    40      // Enough for more than 1e14 values
+// Items needed for every level at capacity
+#define LSTAT_CAP       (3*LSTAT_K + (LSTAT_MINCAP+1)*LSTAT_LEVELS)
+#define LSTAT_MAX_STR   32
+// Identifies a saved summary line and its format
+#define LSTAT_TAG       "lstat1"
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    // Moments
+    unsigned long long n;       // Number of finite values
+    unsigned long long nonfinite;   // Number of NaN and infinite values
+    double mean, m2;            // Running mean and sum of squared deviations
+    double min, max;
+    // Quantile sketch
+    unsigned int levels;        // Number of levels in use
+    // Level h is item[start[h]] to item[start[h+1]-1]
+    unsigned int start[LSTAT_LEVELS+1];
+    uint32_t seed;              // For the random compaction offsets
+    double item[LSTAT_CAP];
+} LSTAT;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LSTAT_INIT
+.   Initialize an empty summary.
+*/
+void lstat_init(LSTAT* s);
+
+/* LSTAT_ADD
+.   Add one value.  NaN and infinite values are counted but otherwise
+.   ignored.
+*/
+void lstat_add(LSTAT* s, const double x);
+
+/* LSTAT_BLOCK
+.   Add n values found stride doubles apart (e.g. one channel of a block of
+.   interleaved samples), calibrated by slope * (x - zero).
+*/
+void lstat_block(LSTAT* s, const double* data, const unsigned int stride,
+                const unsigned int n, const double slope, const double zero);
+
+/* LSTAT_MERGE
+.   Add the values summarized by src to dest.
+*/
+void lstat_merge(LSTAT* dest, const LSTAT* src);
+
+/* LSTAT_STD
+.   Return the sample standard deviation, or NAN for fewer than 2 values.
+*/
+double lstat_std(const LSTAT* s);
+
+/* LSTAT_QUANTILES
+.   Estimate the quantiles q[0..nq-1] (each 0 to 1) and write them to out.
+.   q = 0 and q = 1 give the exact extrema.  If there are no values, the
+.   results are NAN.
+*/
+void lstat_quantiles(const LSTAT* s, const double* q, const unsigned int nq,
+                double* out);
+
+/* LSTAT_NAME
+.   Copy name to dest (LSTAT_MAX_STR characters) with any white space
+.   replaced by underscores, so that it can tag a summary.
+*/
+void lstat_name(char* dest, const char* name);
+
+/* LSTAT_WRITE
+.   Write the summary on one line, tagged with a name (which must not
+.   contain white space; see lstat_name()).
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int lstat_write(FILE* ff, const char* name, const LSTAT* s);
+
+/* LSTAT_READ
+.   Read a summary written by lstat_write() from the start of line.  name
+.   must have room for LSTAT_MAX_STR characters.
+.
+.   Returns 0 on success and 1 if the line is not a valid summary.
+*/
+int lstat_read(const char* line, char* name, LSTAT* s);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+void lstat_init(LSTAT* s){
+    unsigned int ii;
+    s->n = s->nonfinite = 0;
+    s->mean = s->m2 = 0.;
+    s->min = s->max = NAN;
+    s->levels = 1;
+    for(ii=0; ii<=LSTAT_LEVELS; ii++)
+        s->start[ii] = LSTAT_CAP;
+    s->seed = 0x9E3779B9u;
+}
+
+//******************************************************************************
+// Capacity of level h
+static unsigned int lstat_capacity(const LSTAT* s, const unsigned int h){
+    unsigned int cap;
+    cap = (unsigned int) ceil(LSTAT_K * pow(2./3., s->levels - 1 - h));
+    return cap > LSTAT_MINCAP ? cap : LSTAT_MINCAP;
+}
+
+//******************************************************************************
+static int lstat_compare(const void* a, const void* b){
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+//******************************************************************************
+// Promote half of level h to level h+1 and free the space it used
+static void lstat_compact(LSTAT* s, const unsigned int h){
+    unsigned int a, b, n, odd, half, offset, gap, ii;
+
+    if(h+1 == s->levels){
+        // Unreachable in practice; see LSTAT_LEVELS
+        if(s->levels == LSTAT_LEVELS)
+            return;
+        s->levels++;
+    }
+    a = s->start[h];
+    b = s->start[h+1];
+    n = b - a;
+    // An odd item out stays behind
+    odd = n % 2;
+    half = (n - odd) / 2;
+    if(half == 0)
+        return;
+    qsort(&s->item[a + odd], n - odd, sizeof(double), lstat_compare);
+    s->seed ^= s->seed << 13;
+    s->seed ^= s->seed >> 17;
+    s->seed ^= s->seed << 5;
+    offset = s->seed & 1;
+    // Move the survivors to the top of the level so they join level h+1.
+    // Working down, no survivor is overwritten before it is moved.
+    for(ii=half; ii>0; ii--)
+        s->item[b - half + ii - 1] = s->item[a + odd + offset + 2*(ii-1)];
+    s->start[h+1] = b - half;
+    // Shift the lower levels (and the odd item) up into the freed space
+    gap = (b - half) - (a + odd);
+    memmove(&s->item[s->start[0] + gap], &s->item[s->start[0]],
+            (a + odd - s->start[0]) * sizeof(double));
+    for(ii=0; ii<=h; ii++)
+        s->start[ii] += gap;
+}
+
+//******************************************************************************
+// Compact the lowest level at capacity.  When the array is full, there is
+// always one.
+static void lstat_compress(LSTAT* s){
+    unsigned int h;
+    for(h=0; h<s->levels; h++)
+        if(s->start[h+1] - s->start[h] >= lstat_capacity(s, h)){
+            lstat_compact(s, h);
+            return;
+        }
+    lstat_compact(s, s->levels-1);
+}
+
+//******************************************************************************
+// Add an item with weight 2**h to level h
+static void lstat_push(LSTAT* s, const unsigned int h, const double x){
+    unsigned int ii;
+    while(s->start[0] == 0)
+        lstat_compress(s);
+    // Shift the lower levels down one to open a slot at the bottom of h
+    if(h > 0)
+        memmove(&s->item[s->start[0] - 1], &s->item[s->start[0]],
+                (s->start[h] - s->start[0]) * sizeof(double));
+    for(ii=0; ii<=h; ii++)
+        s->start[ii]--;
+    s->item[s->start[h]] = x;
+}
+
+//******************************************************************************
+void lstat_add(LSTAT* s, const double x){
+    double delta;
+    if(!isfinite(x)){
+        s->nonfinite++;
+        return;
+    }
+    // Welford's running mean and variance
+    s->n++;
+    delta = x - s->mean;
+    s->mean += delta / s->n;
+    s->m2 += delta * (x - s->mean);
+    if(s->n == 1 || x < s->min)
+        s->min = x;
+    if(s->n == 1 || x > s->max)
+        s->max = x;
+    // Level 0 grows down into the free space
+    if(s->start[0] == 0)
+        lstat_compress(s);
+    s->item[--s->start[0]] = x;
+}
+
+//******************************************************************************
+void lstat_block(LSTAT* s, const double* data, const unsigned int stride,
+                const unsigned int n, const double slope, const double zero){
+    unsigned int ii;
+    for(ii=0; ii<n; ii++)
+        lstat_add(s, slope * (data[ii*stride] - zero));
+}
+
+//******************************************************************************
+void lstat_merge(LSTAT* dest, const LSTAT* src){
+    unsigned long long n;
+    double delta;
+    unsigned int h, ii;
+
+    if(src->n){
+        // Chan's parallel combination of the moments
+        n = dest->n + src->n;
+        delta = src->mean - dest->mean;
+        dest->m2 += src->m2 + delta * delta * ((double)dest->n * src->n / n);
+        dest->mean += delta * src->n / n;
+        if(dest->n == 0 || src->min < dest->min)
+            dest->min = src->min;
+        if(dest->n == 0 || src->max > dest->max)
+            dest->max = src->max;
+        dest->n = n;
+    }
+    dest->nonfinite += src->nonfinite;
+
+    // Items keep their weights by joining the same level
+    while(dest->levels < src->levels)
+        dest->levels++;
+    for(h=0; h<src->levels; h++)
+        for(ii=src->start[h]; ii<src->start[h+1]; ii++)
+            lstat_push(dest, h, src->item[ii]);
+}
+
+//******************************************************************************
+double lstat_std(const LSTAT* s){
+    return s->n > 1 ? sqrt(s->m2 / (s->n - 1)) : NAN;
+}
+
+//******************************************************************************
+typedef struct {
+    double x;
+    double w;
+} LSTAT_ITEM;
+
+static int lstat_compare_item(const void* a, const void* b){
+    double x = ((const LSTAT_ITEM*)a)->x, y = ((const LSTAT_ITEM*)b)->x;
+    return (x > y) - (x < y);
+}
+
+//******************************************************************************
+void lstat_quantiles(const LSTAT* s, const double* q, const unsigned int nq,
+                double* out){
+    LSTAT_ITEM items[LSTAT_CAP];
+    unsigned int h, ii, jj, count = 0;
+    double total = 0., sum, target;
+
+    for(h=0; h<s->levels; h++)
+        for(ii=s->start[h]; ii<s->start[h+1]; ii++){
+            items[count].x = s->item[ii];
+            items[count++].w = ldexp(1., h);
+            total += ldexp(1., h);
+        }
+    qsort(items, count, sizeof(LSTAT_ITEM), lstat_compare_item);
+
+    for(jj=0; jj<nq; jj++){
+        if(s->n == 0 || count == 0)
+            out[jj] = NAN;
+        else if(q[jj] <= 0.)
+            out[jj] = s->min;
+        else if(q[jj] >= 1.)
+            out[jj] = s->max;
+        else{
+            // The first item whose cumulative weight reaches the rank
+            target = q[jj] * total;
+            sum = 0.;
+            for(ii=0; ii<count-1; ii++){
+                sum += items[ii].w;
+                if(sum >= target)
+                    break;
+            }
+            out[jj] = items[ii].x;
+        }
+    }
+}
+
+//******************************************************************************
+void lstat_name(char* dest, const char* name){
+    unsigned int ii;
+    for(ii=0; name[ii] && ii<LSTAT_MAX_STR-1; ii++)
+        dest[ii] = isspace((unsigned char)name[ii]) ? '_' : name[ii];
+    dest[ii] = '\0';
+}
+
+//******************************************************************************
+int lstat_write(FILE* ff, const char* name, const LSTAT* s){
+    unsigned int h, ii;
+
+    fprintf(ff, "%s %s %llu %llu %.17g %.17g %.17g %.17g %u", LSTAT_TAG, name,
+            s->n, s->nonfinite, s->mean, s->m2, s->min, s->max, s->levels);
+    for(h=0; h<s->levels; h++)
+        fprintf(ff, " %u", s->start[h+1] - s->start[h]);
+    for(ii=s->start[0]; ii<LSTAT_CAP; ii++)
+        fprintf(ff, " %.17g", s->item[ii]);
+    return fputc('\n', ff) == EOF;
+}
+
+//******************************************************************************
+int lstat_read(const char* line, char* name, LSTAT* s){
+    char tag[16];
+    const char* ptr;
+    char* end;
+    unsigned int h, ii, size[LSTAT_LEVELS], total = 0;
+    int length;
+
+    lstat_init(s);
+    if(sscanf(line, "%15s %31s %llu %llu %lf %lf %lf %lf %u%n", tag, name,
+            &s->n, &s->nonfinite, &s->mean, &s->m2, &s->min, &s->max,
+            &s->levels, &length) != 9 || strcmp(tag, LSTAT_TAG) ||
+            s->levels < 1 || s->levels > LSTAT_LEVELS)
+        return 1;
+    ptr = line + length;
+    for(h=0; h<s->levels; h++){
+        size[h] = strtoul(ptr, &end, 10);
+        if(end == ptr)
+            return 1;
+        ptr = end;
+        total += size[h];
+        if(total > LSTAT_CAP)
+            return 1;
+    }
+    // Rebuild the level boundaries from the top down
+    s->start[s->levels] = LSTAT_CAP;
+    for(h=s->levels; h>0; h--)
+        s->start[h-1] = s->start[h] - size[h-1];
+    for(h=s->levels+1; h<=LSTAT_LEVELS; h++)
+        s->start[h] = LSTAT_CAP;
+    for(ii=s->start[0]; ii<LSTAT_CAP; ii++){
+        s->item[ii] = strtod(ptr, &end);
+        if(end == ptr)
+            return 1;
+        ptr = end;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,224 @@
+/*
+.
+.   Tools for supervising device connections
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LSUP tracks the state of one device connection.  The host reports
+.   failures and successes; LSUP decides when the next reconnect attempt is
+.   due (with exponential backoff) and accounts for every gap in the data:
+.   when it started, how long it lasted, and how many samples were lost.
+.   Each transition is written to a log file as it happens.
+.
+.   LSUP never blocks.  The host loop keeps running (and keeps the display
+.   and the other device alive) while a device is down, and only makes a
+.   reconnect attempt when lsup_ready() says one is due.
+.
+*/
+
+
+#ifndef __LSUP
+#define __LSUP
+
+
+// Add some headers
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "lclock.h"         // For the monotonic clock
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LSUP_VERSION
+Date
+Notes
+
+**1.0
+Original version.  Exponential backoff and gap accounting.
+
+**1.1
+Times come from lclock_now() in lclock.h.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LSUP_VERSION 1.1
+
+#define LSUP_MAX_STR        32
+// Reconnect backoff in seconds; it starts at LSUP_BACKOFF_MIN and doubles
+// after each failed attempt up to LSUP_BACKOFF_MAX.
+#define LSUP_BACKOFF_MIN    0.5
+#define LSUP_BACKOFF_MAX    30.
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    char name[LSUP_MAX_STR];    // Device name used in the log
+    FILE* log;                  // Gap log; may be NULL
+    double samplehz;            // Stream rate used to count lost samples;
+                                // 0 for polled devices
+    // Connection state
+    int up;                     // 1 while connected
+    unsigned int attempts;      // Failed attempts in the current gap
+    double backoff;             // Current backoff (s)
+    double next;                // Monotonic time of the next attempt (s)
+    double down_mono;           // Monotonic time the gap began (s)
+    time_t down_real;           // Wall clock time the gap began
+    // Gap accounting
+    unsigned long ngaps;        // Number of completed gaps
+    double last_gap;            // Duration of the last completed gap (s)
+    double total_gap;           // Total duration of completed gaps (s)
+    unsigned long lost;         // Total samples lost
+} LSUP;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LSUP_INIT
+.   Initialize a supervisor for a device that is currently connected.
+.
+.   name        Device name for the log and display
+.   samplehz    Stream rate; 0 if the device is polled
+.   log         Open log file, or NULL
+*/
+void lsup_init(LSUP* sup, const char* name, const double samplehz, FILE* log);
+
+/* LSUP_FAIL
+.   Report a failed operation.  If the device was up, a gap begins and the
+.   first reconnect attempt is due immediately.  If the device was already
+.   down, this counts as a failed reconnect attempt and the backoff is
+.   doubled.  reason is written to the log.
+*/
+void lsup_fail(LSUP* sup, const char* reason);
+
+/* LSUP_READY
+.   Returns 1 if the device is down and a reconnect attempt is due, and 0
+.   otherwise.
+*/
+int lsup_ready(LSUP* sup);
+
+/* LSUP_RESTORED
+.   Report a successful reconnect.  The gap is closed and logged.
+*/
+void lsup_restored(LSUP* sup);
+
+/* LSUP_DOWNTIME
+.   Returns the duration of the current gap in seconds, or 0 if the device
+.   is up.
+*/
+double lsup_downtime(LSUP* sup);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+// Format a wall clock time for the log
+static void lsup_time(time_t t, char* buffer, const size_t length){
+    strftime(buffer, length, "%Y-%m-%d %H:%M:%S", localtime(&t));
+}
+
+//******************************************************************************
+void lsup_init(LSUP* sup, const char* name, const double samplehz, FILE* log){
+    memset(sup, 0, sizeof(LSUP));
+    strncpy(sup->name, name, LSUP_MAX_STR-1);
+    sup->samplehz = samplehz;
+    sup->log = log;
+    sup->up = 1;
+    sup->backoff = LSUP_BACKOFF_MIN;
+}
+
+//******************************************************************************
+void lsup_fail(LSUP* sup, const char* reason){
+    char stamp[32];
+    double now;
+
+    now = lclock_now();
+    if(sup->up){
+        sup->up = 0;
+        sup->attempts = 0;
+        sup->backoff = LSUP_BACKOFF_MIN;
+        sup->down_mono = now;
+        sup->down_real = time(NULL);
+        sup->next = now;
+        if(sup->log){
+            lsup_time(sup->down_real, stamp, sizeof(stamp));
+            fprintf(sup->log, "%s %s down: %s\n", stamp, sup->name, reason);
+            fflush(sup->log);
+        }
+        return;
+    }
+    // A failed reconnect attempt
+    sup->attempts++;
+    sup->next = now + sup->backoff;
+    sup->backoff *= 2.;
+    if(sup->backoff > LSUP_BACKOFF_MAX)
+        sup->backoff = LSUP_BACKOFF_MAX;
+}
+
+//******************************************************************************
+int lsup_ready(LSUP* sup){
+    return !sup->up && lclock_now() >= sup->next;
+}
+
+//******************************************************************************
+void lsup_restored(LSUP* sup){
+    char stamp[32], start[32];
+    double gap;
+    unsigned long lost;
+
+    if(sup->up)
+        return;
+    gap = lclock_now() - sup->down_mono;
+    lost = (unsigned long)(gap * sup->samplehz + 0.5);
+    sup->up = 1;
+    sup->ngaps++;
+    sup->last_gap = gap;
+    sup->total_gap += gap;
+    sup->lost += lost;
+    if(sup->log){
+        lsup_time(time(NULL), stamp, sizeof(stamp));
+        lsup_time(sup->down_real, start, sizeof(start));
+        fprintf(sup->log, "%s %s restored: gap from %s lasted %.3f s; "
+                "%u failed attempts", stamp, sup->name, start, gap,
+                sup->attempts);
+        if(sup->samplehz > 0.)
+            fprintf(sup->log, "; %lu samples lost", lost);
+        fputc('\n', sup->log);
+        fflush(sup->log);
+    }
+}
+
+//******************************************************************************
+double lsup_downtime(LSUP* sup){
+    return sup->up ? 0. : lclock_now() - sup->down_mono;
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+.
+.   Tools for converting type K thermocouple voltages offline
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LTC evaluates the NIST ITS-90 type K polynomials (the same coefficients
+.   used by py/tc.py) so that thermocouple voltages can be converted without
+.   a device connection.  The monitor converts its live readings with these
+.   functions, so reprocessed data files match them given the same cold
+.   junction temperature.
+.
+*/
+
+
+#ifndef __LTC
+#define __LTC
+
+
+// Add some headers
+#include <math.h>
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LTC_VERSION
+Date
+Notes
+
+**1.0
+Original version.  Type K only.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LTC_VERSION 1.0
+
+// Valid ranges of the type K polynomials
+#define LTC_K_TMIN_C        -270.
+#define LTC_K_TMAX_C        1372.
+#define LTC_K_MVMIN         -5.891
+#define LTC_K_MVMAX         54.886
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LTC_K_MV
+.   Return the type K thermocouple voltage in mV for a junction at T_C
+.   degrees C referenced to 0 C.  Returns NAN outside the valid range.
+*/
+double ltc_k_mv(const double T_C);
+
+/* LTC_K_T
+.   Return the type K junction temperature in degrees C given the measured
+.   voltage in V and the cold junction temperature in degrees C.  Returns
+.   NAN if the compensated voltage is outside the valid range.
+*/
+double ltc_k_t(const double volts, const double Tcj_C);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+// Evaluate a polynomial with n coefficients by Horner's rule
+static double ltc_poly(const double* c, const unsigned int n, const double x){
+    double y;
+    unsigned int ii;
+    y = c[n-1];
+    for(ii=n-1; ii>0; ii--)
+        y = y*x + c[ii-1];
+    return y;
+}
+
+//******************************************************************************
+double ltc_k_mv(const double T_C){
+    static const double low[] = {0.000000000000, 0.394501280250e-1,
+        0.236223735980e-4, -0.328589067840e-6, -0.499048287770e-8,
+        -0.675090591730e-10, -0.574103274280e-12, -0.310888728940e-14,
+        -0.104516093650e-16, -0.198892668780e-19, -0.163226974860e-22};
+    static const double high[] = {-0.176004136860e-1, 0.389212049750e-1,
+        0.185587700320e-4, -0.994575928740e-7, 0.318409457190e-9,
+        -0.560728448890e-12, 0.560750590590e-15, -0.320207200030e-18,
+        0.971511471520e-22, -0.121047212750e-25};
+    // Exponential correction terms above 0 C
+    static const double a0 = 0.118597600000, a1 = -0.118343200000e-3,
+        a2 = 0.126968600000e3;
+
+    if(T_C < LTC_K_TMIN_C || T_C > LTC_K_TMAX_C)
+        return NAN;
+    else if(T_C <= 0.)
+        return ltc_poly(low, sizeof(low)/sizeof(double), T_C);
+    return ltc_poly(high, sizeof(high)/sizeof(double), T_C) +
+            a0 * exp(a1 * (T_C - a2) * (T_C - a2));
+}
+
+//******************************************************************************
+double ltc_k_t(const double volts, const double Tcj_C){
+    static const double c0[] = {0.000000, 2.5173462e1, -1.1662878,
+        -1.0833638, -8.9773540e-1, -3.7342377e-1, -8.6632643e-2,
+        -1.0450598e-2, -5.1920577e-4};
+    static const double c1[] = {0.000000, 2.508355e1, 7.860106e-2,
+        -2.503131e-1, 8.315270e-2, -1.228034e-2, 9.804036e-4, -4.413030e-5,
+        1.057734e-6, -1.052755e-8};
+    static const double c2[] = {-1.318058e2, 4.830222e1, -1.646031e0,
+        5.464731e-2, -9.650715e-4, 8.802193e-6, -3.110810e-8};
+    double mV;
+
+    // Add the cold junction voltage
+    mV = 1000. * volts + ltc_k_mv(Tcj_C);
+    if(isnan(mV) || mV < LTC_K_MVMIN || mV > LTC_K_MVMAX)
+        return NAN;
+    else if(mV <= 0.)
+        return ltc_poly(c0, sizeof(c0)/sizeof(double), mV);
+    else if(mV <= 20.644)
+        return ltc_poly(c1, sizeof(c1)/sizeof(double), mV);
+    return ltc_poly(c2, sizeof(c2)/sizeof(double), mV);
+}
+
+#endif
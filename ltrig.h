@@ -0,0 +1,469 @@
+/*
+.
+.   Tools for capturing triggered events from a live sample stream
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LTRIG watches blocks of interleaved samples for level crossings and keeps
+.   the most recent samples in a fixed-size pre-trigger ring.  When a trigger
+.   fires, the pre-trigger ring and the post-trigger window are written to an
+.   LCONFIG data file that can be loaded directly by LConf in lconfig.py.
+.   Nothing is written to disk while the signal is idle.
+.
+.   If a raw count format is given (see lraw.h), the ring and the capture
+.   files hold integer counts instead of doubles, so the same memory holds a
+.   2-4x longer pre-trigger window.
+.
+*/
+
+
+#ifndef __LTRIG
+#define __LTRIG
+
+
+// Add some headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "lraw.h"
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LTRIG_VERSION
+Date
+Notes
+
+**1.0
+Original version.  Level/edge conditions with debounce, pre-trigger ring,
+and post-trigger capture to LCONFIG data files.
+
+**1.1
+Optional raw count storage in the ring and capture files.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LTRIG_VERSION 1.1
+
+// Maximum number of simultaneous trigger conditions
+#define LTRIG_MAX_COND      4
+// Maximum number of channels in a sample
+#define LTRIG_MAX_CH        16
+// Maximum length of file names
+#define LTRIG_MAX_STR       128
+
+// Edge types
+#define LTRIG_ANY           0
+#define LTRIG_RISING        1
+#define LTRIG_FALLING       -1
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+/* LTRIG_COND
+.   A single level crossing condition.  The semantics are identical to the
+.   get_events() method in lconfig.py; the channel value is calibrated by
+.
+.       value = slope * (raw - zero)
+.
+.   and compared against level.  A transition is only recognized once the new
+.   state has persisted for debounce consecutive samples.  Redundant
+.   transitions inside that window are conflated into a single edge.
+*/
+typedef struct {
+    unsigned int channel;   // Column of the channel in each sample
+    int edge;               // LTRIG_RISING, LTRIG_FALLING, or LTRIG_ANY
+    double level;           // Crossing level in calibrated units
+    unsigned int debounce;  // Samples required to confirm a transition
+    double slope, zero;     // Channel calibration
+    // State
+    char started;           // Has the first sample been seen?
+    char test_last;         // Was the last sample above the level?
+    unsigned long series;   // Number of consecutive samples in this state
+    long long rising;       // Candidate rising edge index or -1
+    long long falling;      // Candidate falling edge index or -1
+} LTRIG_COND;
+
+
+typedef struct {
+    LTRIG_COND cond[LTRIG_MAX_COND];
+    unsigned int ncond;
+    unsigned int channels;      // Number of channels per sample
+    // Pre-trigger ring
+    char* ring;                 // pre rows of rowsize bytes
+    size_t rowsize;             // Bytes per ring row
+    LRAW raw;                   // Raw count format if raw.size is nonzero
+    unsigned int pre;           // Ring capacity in samples
+    unsigned int head;          // Next ring row to write
+    unsigned int fill;          // Number of valid rows in the ring
+    // Capture state
+    unsigned int post;          // Post-trigger window in samples
+    unsigned int remaining;     // Samples left in the current capture
+    unsigned long long index;   // Stream index of the next sample
+    FILE* out;                  // Current capture file or NULL
+    char prefix[LTRIG_MAX_STR]; // Capture file prefix
+    char config[LTRIG_MAX_STR]; // Configuration file copied as the header
+    unsigned int nevents;       // Number of captures started
+} LTRIG;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LTRIG_INIT
+.   Initialize the trigger engine and allocate the pre-trigger ring.
+.
+.   channels    Number of interleaved channels in each sample
+.   pre         Pre-trigger ring length in samples
+.   post        Post-trigger window in samples
+.   prefix      Capture files are named prefix_NNNN.dat
+.   config      The LCONFIG configuration file that will be copied into the
+.               header of each capture so that LConf can load it.  May be NULL.
+.   raw         Raw count format for the ring and captures.  If NULL, samples
+.               are stored as doubles.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int ltrig_init(LTRIG* trig, const unsigned int channels,
+                const unsigned int pre, const unsigned int post,
+                const char* prefix, const char* config, const LRAW* raw);
+
+/* LTRIG_ADD
+.   Add a condition to the trigger.  The edge string may be "rising",
+.   "falling", or "any".
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int ltrig_add(LTRIG* trig, const unsigned int channel, const char* edge,
+                const double level, const unsigned int debounce,
+                const double slope, const double zero);
+
+/* LTRIG_PARSE
+.   Add a condition from a string of the form
+.
+.       "channel edge level debounce"
+.
+.   For example, "0 rising 0.004 5".  The debounce is optional.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int ltrig_parse(LTRIG* trig, const char* spec,
+                const double* slope, const double* zero);
+
+/* LTRIG_BLOCK
+.   Process a block of interleaved samples.  Every sample is tested against
+.   all conditions and either written to the current capture or retained in
+.   the pre-trigger ring.  A trigger that fires during a capture extends it
+.   by a full post-trigger window.
+.
+.   Returns the number of triggers that fired in the block.
+*/
+int ltrig_block(LTRIG* trig, const double* data, const unsigned int samples);
+
+/* LTRIG_BREAK
+.   Mark a gap in the stream, as when it is restarted.  The pre-trigger
+.   ring is emptied, any capture in progress is closed, and the conditions
+.   start over, so no capture joins samples from either side of the gap.
+*/
+void ltrig_break(LTRIG* trig);
+
+/* LTRIG_FREE
+.   Close any open capture and release the ring.
+*/
+void ltrig_free(LTRIG* trig);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+int ltrig_init(LTRIG* trig, const unsigned int channels,
+                const unsigned int pre, const unsigned int post,
+                const char* prefix, const char* config, const LRAW* raw){
+
+    memset(trig, 0, sizeof(LTRIG));
+    if(channels == 0 || channels > LTRIG_MAX_CH){
+        printf("LTRIG_INIT: Channel count %u is out of range.\n", channels);
+        return 1;
+    }else if(raw && raw->channels != channels){
+        printf("LTRIG_INIT: Raw format has %u channels; expected %u.\n",
+                raw->channels, channels);
+        return 1;
+    }
+    if(raw){
+        trig->raw = *raw;
+        trig->rowsize = channels * raw->size;
+    }else
+        trig->rowsize = channels * sizeof(double);
+    trig->channels = channels;
+    trig->pre = pre;
+    trig->post = post;
+    strncpy(trig->prefix, prefix, LTRIG_MAX_STR-1);
+    if(config)
+        strncpy(trig->config, config, LTRIG_MAX_STR-1);
+    if(pre){
+        trig->ring = malloc(pre * trig->rowsize);
+        if(trig->ring == NULL){
+            printf("LTRIG_INIT: Failed to allocate a %u sample ring.\n", pre);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//******************************************************************************
+int ltrig_add(LTRIG* trig, const unsigned int channel, const char* edge,
+                const double level, const unsigned int debounce,
+                const double slope, const double zero){
+    LTRIG_COND* cond;
+
+    if(trig->ncond >= LTRIG_MAX_COND){
+        printf("LTRIG_ADD: Too many trigger conditions.\n");
+        return 1;
+    }else if(channel >= trig->channels){
+        printf("LTRIG_ADD: Channel %u is out of range.\n", channel);
+        return 1;
+    }
+    cond = &trig->cond[trig->ncond];
+    memset(cond, 0, sizeof(LTRIG_COND));
+
+    if(strcmp(edge, "rising")==0)
+        cond->edge = LTRIG_RISING;
+    else if(strcmp(edge, "falling")==0)
+        cond->edge = LTRIG_FALLING;
+    else if(strcmp(edge, "any")==0 || strcmp(edge, "all")==0)
+        cond->edge = LTRIG_ANY;
+    else{
+        printf("LTRIG_ADD: Unrecognized edge: %s\n", edge);
+        return 1;
+    }
+    cond->channel = channel;
+    cond->level = level;
+    cond->debounce = debounce ? debounce : 1;
+    cond->slope = slope;
+    cond->zero = zero;
+    cond->rising = -1;
+    cond->falling = -1;
+    trig->ncond++;
+    return 0;
+}
+
+//******************************************************************************
+int ltrig_parse(LTRIG* trig, const char* spec,
+                const double* slope, const double* zero){
+    unsigned int channel, debounce = 1;
+    char edge[16];
+    double level;
+
+    if(sscanf(spec, "%u %15s %lf %u", &channel, edge, &level, &debounce) < 3){
+        printf("LTRIG_PARSE: Expected \"channel edge level debounce\": %s\n", spec);
+        return 1;
+    }
+    if(channel >= trig->channels){
+        printf("LTRIG_PARSE: Channel %u is out of range.\n", channel);
+        return 1;
+    }
+    return ltrig_add(trig, channel, edge, level, debounce,
+            slope ? slope[channel] : 1., zero ? zero[channel] : 0.);
+}
+
+//******************************************************************************
+// Advance a condition's state machine by one sample.  This is a sample-by-
+// sample transcription of LConf.get_events().  Returns 1 if an edge was
+// confirmed on this sample.
+static int ltrig_test(LTRIG_COND* cond, const double raw,
+                const unsigned long long index){
+    char test;
+    int fired = 0;
+
+    test = (cond->slope * (raw - cond->zero)) > cond->level;
+    if(!cond->started){
+        cond->started = 1;
+        cond->test_last = test;
+        cond->series = 1;
+        return 0;
+    }
+
+    if(test == cond->test_last)
+        cond->series++;
+    else
+        cond->series = 1;
+
+    if(cond->series >= cond->debounce){
+        if(test){
+            cond->falling = index;
+            if(cond->rising >= 0 && cond->edge >= 0){
+                fired = 1;
+                cond->rising = -1;
+            }
+        }else{
+            cond->rising = index;
+            if(cond->falling >= 0 && cond->edge <= 0){
+                fired = 1;
+                cond->falling = -1;
+            }
+        }
+    }
+    cond->test_last = test;
+    return fired;
+}
+
+//******************************************************************************
+// Write a row that is already in ring format
+static void ltrig_write_row(LTRIG* trig, const void* row){
+    unsigned int ii;
+    if(trig->raw.size){
+        lraw_write_row(&trig->raw, trig->out, row);
+        return;
+    }
+    for(ii=0; ii<trig->channels; ii++)
+        fprintf(trig->out, "%.6e\t", ((const double*)row)[ii]);
+    fputc('\n', trig->out);
+}
+
+//******************************************************************************
+// Start a new capture file: copy the configuration header, add meta
+// parameters describing the capture, then dump the pre-trigger ring.
+static int ltrig_start(LTRIG* trig){
+    char filename[LTRIG_MAX_STR + 16];
+    char line[256];
+    FILE* config;
+    time_t now;
+    unsigned int ii, row;
+
+    sprintf(filename, "%s_%04u.dat", trig->prefix, trig->nevents);
+    trig->out = fopen(filename, "w");
+    if(trig->out == NULL){
+        printf("LTRIG: Failed to open capture file %s\n", filename);
+        return 1;
+    }
+    trig->nevents++;
+
+    // Copy the configuration up to the end-of-config marker
+    if(trig->config[0] && (config = fopen(trig->config, "r"))){
+        while(fgets(line, sizeof(line), config) && strncmp(line, "##", 2))
+            fputs(line, trig->out);
+        fclose(config);
+    }
+    fprintf(trig->out, "\nint:trigevent %u\nint:trigpre %u\nint:trigindex %llu\n",
+            trig->nevents-1, trig->fill, trig->index - trig->fill);
+    if(trig->raw.size)
+        lraw_write_meta(&trig->raw, trig->out);
+    fputs("##\n", trig->out);
+    time(&now);
+    fputs(ctime(&now), trig->out);
+
+    // Dump the pre-trigger ring oldest first
+    row = (trig->head + trig->pre - trig->fill) % (trig->pre ? trig->pre : 1);
+    for(ii=0; ii<trig->fill; ii++){
+        ltrig_write_row(trig, &trig->ring[row*trig->rowsize]);
+        row = (row + 1) % trig->pre;
+    }
+    // Samples that were written are not pre-trigger data for the next event
+    trig->fill = 0;
+    return 0;
+}
+
+//******************************************************************************
+int ltrig_block(LTRIG* trig, const double* data, const unsigned int samples){
+    unsigned int ii, jj;
+    const double* row;
+    char* dest;
+    double encoded[LTRIG_MAX_CH];
+    int fired, count = 0;
+
+    for(ii=0; ii<samples; ii++, trig->index++){
+        row = &data[ii*trig->channels];
+        fired = 0;
+        for(jj=0; jj<trig->ncond; jj++)
+            fired |= ltrig_test(&trig->cond[jj], row[trig->cond[jj].channel],
+                    trig->index);
+
+        if(fired){
+            count++;
+            if(trig->out == NULL)
+                ltrig_start(trig);
+            trig->remaining = trig->post + 1;
+        }
+
+        // During a capture, write straight to disk
+        // Otherwise, retain the sample in the pre-trigger ring
+        if(trig->out)
+            dest = (char*) encoded;
+        else if(trig->pre)
+            dest = &trig->ring[trig->head*trig->rowsize];
+        else
+            continue;
+
+        if(trig->raw.size)
+            lraw_encode(&trig->raw, row, dest, 1);
+        else
+            memcpy(dest, row, trig->rowsize);
+
+        if(trig->out){
+            ltrig_write_row(trig, dest);
+            if(--trig->remaining == 0){
+                fclose(trig->out);
+                trig->out = NULL;
+            }
+        }else{
+            trig->head = (trig->head + 1) % trig->pre;
+            if(trig->fill < trig->pre)
+                trig->fill++;
+        }
+    }
+    return count;
+}
+
+//******************************************************************************
+void ltrig_break(LTRIG* trig){
+    unsigned int ii;
+    if(trig->out)
+        fclose(trig->out);
+    trig->out = NULL;
+    trig->remaining = 0;
+    trig->fill = 0;
+    for(ii=0; ii<trig->ncond; ii++){
+        trig->cond[ii].started = 0;
+        trig->cond[ii].series = 0;
+        trig->cond[ii].rising = trig->cond[ii].falling = -1;
+    }
+}
+
+//******************************************************************************
+void ltrig_free(LTRIG* trig){
+    if(trig->out)
+        fclose(trig->out);
+    trig->out = NULL;
+    if(trig->ring)
+        free(trig->ring);
+    trig->ring = NULL;
+}
+
+#endif
@@ -0,0 +1,173 @@
+/*
+.
+.   Tools for noticing when a file has been rewritten
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   LWATCH uses inotify to watch a single file, such as a configuration file,
+.   for changes.  The file's directory is watched rather than the file, so
+.   editors that save by writing a new file and renaming it over the old one
+.   are seen as well as those that rewrite the file in place.  Checking for
+.   changes never blocks.
+.
+*/
+
+
+#ifndef __LWATCH
+#define __LWATCH
+
+
+// Add some headers
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/inotify.h>
+
+
+/* CHANGELOG
+These change logs follow the convention below:
+**LWATCH_VERSION
+Date
+Notes
+
+**1.0
+Original version.
+*/
+
+
+
+
+/****************************
+ *                          *
+ *       Constants          *
+ *                          *
+ ****************************/
+
+#define LWATCH_VERSION 1.0
+
+#define LWATCH_MAX_STR      256
+// Events that indicate a completed write
+#define LWATCH_EVENTS       (IN_CLOSE_WRITE | IN_MOVED_TO)
+
+
+
+/****************************
+ *                          *
+ *         Types            *
+ *                          *
+ ****************************/
+
+typedef struct {
+    int fd;                     // inotify descriptor or -1
+    int wd;                     // Watch descriptor of the directory
+    char name[LWATCH_MAX_STR];  // File name within the directory
+} LWATCH;
+
+
+
+/****************************
+ *                          *
+ *       Prototypes         *
+ *                          *
+ ****************************/
+
+/* LWATCH_OPEN
+.   Begin watching the file at path.
+.
+.   Returns 0 on success and 1 on an error.  On an error, the watch is left
+.   closed and LWATCH_CHANGED always returns 0.
+*/
+int lwatch_open(LWATCH* watch, const char* path);
+
+/* LWATCH_CHANGED
+.   Read all pending events.  Returns 1 if the file was written or replaced
+.   since the last call and 0 otherwise.  Several writes in quick succession
+.   are reported once.
+*/
+int lwatch_changed(LWATCH* watch);
+
+/* LWATCH_CLOSE
+.   Stop watching.
+*/
+void lwatch_close(LWATCH* watch);
+
+
+
+/****************************
+ *                          *
+ *       Algorithm          *
+ *                          *
+ ****************************/
+
+//******************************************************************************
+int lwatch_open(LWATCH* watch, const char* path){
+    char dir[LWATCH_MAX_STR];
+    const char* slash;
+
+    memset(watch, 0, sizeof(LWATCH));
+    watch->fd = -1;
+    if(strlen(path) >= LWATCH_MAX_STR){
+        printf("LWATCH_OPEN: Path is too long: %s\n", path);
+        return 1;
+    }
+    // Split the path into the directory and the file name
+    slash = strrchr(path, '/');
+    if(slash){
+        strcpy(watch->name, slash+1);
+        memcpy(dir, path, slash - path);
+        dir[slash - path] = '\0';
+        if(dir[0] == '\0')
+            strcpy(dir, "/");
+    }else{
+        strcpy(watch->name, path);
+        strcpy(dir, ".");
+    }
+
+    watch->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(watch->fd < 0){
+        printf("LWATCH_OPEN: Failed to start inotify: %s\n", strerror(errno));
+        return 1;
+    }
+    watch->wd = inotify_add_watch(watch->fd, dir, LWATCH_EVENTS);
+    if(watch->wd < 0){
+        printf("LWATCH_OPEN: Failed to watch %s: %s\n", dir, strerror(errno));
+        lwatch_close(watch);
+        return 1;
+    }
+    return 0;
+}
+
+//******************************************************************************
+int lwatch_changed(LWATCH* watch){
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event* event;
+    ssize_t length;
+    char* ptr;
+    int changed = 0;
+
+    if(watch->fd < 0)
+        return 0;
+    while((length = read(watch->fd, buffer, sizeof(buffer))) > 0)
+        for(ptr = buffer; ptr < buffer + length;
+                ptr += sizeof(struct inotify_event) + event->len){
+            event = (const struct inotify_event*) ptr;
+            if(event->len && strcmp(event->name, watch->name)==0)
+                changed = 1;
+        }
+    return changed;
+}
+
+//******************************************************************************
+void lwatch_close(LWATCH* watch){
+    if(watch->fd >= 0)
+        close(watch->fd);
+    watch->fd = -1;
+}
+
+#endif
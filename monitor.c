@@ -1,8 +1,25 @@
+#define _GNU_SOURCE         // For CPU affinity in lrt.h; must come first
 #include "ldisplay.h"       // For the display helper functions
 #include "lgas.h"           // For gas measurements from the U12
-#include "psat.h"           // For water/steam properties in heat calculations
+#include "lheat.h"          // For the coolant and plate heat balances
+#include "ltc.h"            // For converting thermocouple voltages
+#include "lserve.h"         // For streaming live data to local clients
+#include "ltrig.h"          // For capturing triggered events to disk
+#include "lshm.h"           // For publishing samples in shared memory
+#include "lraw.h"           // For storing samples as raw ADC counts
+#include "lrobust.h"        // For spike rejection in thermocouple blocks
+#include "lrt.h"            // For real-time scheduling and jitter reports
+#include "lsup.h"           // For device reconnects and gap accounting
+#include "lwatch.h"         // For noticing changes to the configuration
+#include "lexpr.h"          // For derived channels and alarms
+#include "lsched.h"         // For the interface, reconnect, and gas tasks
+#include "lstat.h"          // For run statistics and percentiles
+#include "lhist.h"          // For the recent history behind the trends
+#include "lclock.h"         // For stamping samples from the T7's clock
 #include "lconfig.h"
 #include <unistd.h>         
+#include <stdlib.h>
+#include <signal.h>
 
 
 // Where should the columns be displayed on the screen?
@@ -11,7 +28,29 @@
 
 #define CONFIG_FILE "monitor.conf"
 #define NAVG_MAX 1024
+#define NTC 4               // Number of thermocouple channels
 #define INPUT_LEN   128
+#define CAPTURE_FILE "monitor"
+#define SHM_SECONDS 60      // Length of the shared memory ring
+#define LOG_FILE "monitor.log"
+#define READ_TIMEOUT 2.     // Stream read timeout beyond one block (s)
+#define NEXPR 16            // Number of derived and alarm definitions
+#define NDISP 8             // Derived values and alarms shown on screen
+#define GAS_HZ 10.          // Default U12 gas read rate
+#define IDLE_US 50000       // Main loop pause while the T7 is down (us)
+#define UI_HZ 10.           // Display refresh and keyboard poll rate
+#define OUTBUF_LEN 65536    // stdout buffer; holds a whole screen
+#define RECONNECT_HZ 10.    // How often the reconnect task checks for work
+#define T7_IDLE 0           // t7state values: no attempt wanted
+#define T7_WANTED 1         // An attempt is requested or in progress
+#define T7_OPEN 2           // The attempt succeeded; t7conn holds the handle
+#define T7_FAILED 3         // The attempt failed
+#define NSTAT (2*LSERVE_MAX_VALUES) // Values with run statistics, by name
+#define NSPARK 48           // Buckets drawn in each sparkline
+#define NAGE 6              // Sources x stages in age_names[]
+#define AGE_COMPUTE 0       // Stages at which value ages are recorded
+#define AGE_PUBLISH 1
+#define AGE_DISPLAY 2
 
 /********************************
  *                              *
@@ -40,15 +79,162 @@ double  water_gph,          // Water flow in gallons per hour
 // Torch condition
 double  standoff_in;        // Standoff distance in inches
 
+// Threads
+// The main thread runs the acquisition loop: it reads the T7 and publishes
+// the results, and it is the only thread put in real-time mode.  The
+// display, the prompt, configuration parsing, and the summary file run in
+// uitask at normal priority.  datalock guards everything the two share.
+// The loop holds it except while it waits for the T7 (see get_tc()), and
+// uitask only holds it to copy values or to draw into the stdout buffer.
+// The lock uses priority inheritance; when both locks are needed, datalock
+// is taken before gaslock.
+LSCHED  uitask;             // Interface task; see lsched.h
+pthread_mutex_t datalock;
+int     typed = -1;         // Characters typed at the prompt; see poll_prompt()
+char    redraw = 1;         // Redraw the display from scratch?
+unsigned int drawn = 0;     // reloads when the display was last redrawn
+
+// Gas flow meters
+// The U12 is read by gastask in its own thread.  gasmeter, the latest
+// reading, and u12link are shared with it and guarded by gaslock, which
+// uses priority inheritance (see lsched_mutex_init()).
+LGAS    gasmeter;           // U12 meter pair; see lgas.h
+LSCHED  gastask;            // Gas read task; see lsched.h
+pthread_mutex_t gaslock;
+double  gas_o2_scfh,        // Latest oxygen reading (scfh)
+        gas_fg_scfh,        // Latest fuel gas reading (scfh)
+        gas_stamp = 0.;     // Monotonic time of the latest reading (s)
+
+// Acquisition times of the values in use (monotonic s)
+double  gas_time = 0.,      // Gas flows
+        tc_time = 0.;       // Middle sample of the last T7 block
+LCLOCK  t7clock;            // T7 sample clock model; see lclock.h
+
+// Live data server
+LSERVE  server;             // Socket server; see lserve.h
+char    headless = 0;       // Run without the terminal display?
+
+// Event capture
+LTRIG   trigger;            // Trigger engine; see ltrig.h
+
+// Shared memory sample ring
+LSHM    ring;               // Shared memory ring; see lshm.h
+
+// Thermocouple block estimators
+LROB    tcfilter[NTC];      // Robust estimators; see lrobust.h
+
+// Acquisition timing
+LRT     rtstat;             // Read jitter statistics; see lrt.h
+
+// Device connections
+LSUP    t7link, u12link;    // Connection supervisors; see lsup.h
+char    t7stream = 0;       // Is the T7 stream running?
+
+// T7 reconnects
+// Attempts run in t7task so that the loop keeps serving clients while the
+// device times out.  t7state is guarded by t7lock.  While it is T7_WANTED,
+// t7conn belongs to the task.
+LSCHED  t7task;             // Reconnect task; see lsched.h
+pthread_mutex_t t7lock;
+DEVCONF t7conn[1];          // Copy of the configuration to upload
+int     t7state = T7_IDLE;
+unsigned int t7reloads;     // reloads when the attempt was requested
+LSUP    u12snap;            // Copy of u12link for the display
+FILE*   gaplog = NULL;      // Connection gap and reload log
+
+// Configuration reloads
+// uitask reads and checks a changed file into pending, pendfilter, and
+// pendexpr and then sets reload_f.  The acquisition loop applies them and
+// clears it.  Until then, uitask leaves them and the file alone.
+LWATCH  confwatch;          // Watches CONFIG_FILE; see lwatch.h
+DEVCONF pending[1];         // Configuration waiting to be applied
+LROB    pendfilter;         // Its thermocouple estimator
+LEXPR   pendexpr;           // Its derived values and alarms
+char    reload_f = 0;       // Is a checked configuration waiting?
+unsigned int reloads = 0;   // Number of reloads applied
+char    retrigger = 0;      // Re-initialize the trigger after its capture?
+
+// Derived channels and alarms
+LEXPR   derived;            // Expressions from the configuration; see lexpr.h
+
+// Run statistics
+// Values are tracked by name so that they survive reloads
+LSTAT   valstat[NSTAT];     // Published values, once per block; see lstat.h
+LHIST   history[NSTAT];     // Their recent history; see lhist.h
+char    statnames[NSTAT][LSTAT_MAX_STR];
+unsigned int nstat = 0;
+unsigned int pub_stat[LSERVE_MAX_VALUES];   // valstat[] index of each value
+LSTAT   chstat[LSERVE_MAX_CH];  // Every calibrated sample of each channel
+char    chnames[LSERVE_MAX_CH][LSTAT_MAX_STR];
+unsigned int nchstat = 0;
+char    statfile[LCONF_MAX_STR];    // Summary written on exit and on request
+char    statpage = 0;       // Show the statistics instead of the values?
+unsigned int histpage = 0;  // Trend page level plus one; 0 shows the values
+volatile sig_atomic_t dump_f = 0;   // Set by SIGUSR1 to write the summary
+
+// How old the values are when they are computed, sent to clients, and
+// drawn; in the order AGE_XXX for the T7 and then for the U12
+const char* age_names[NAGE] = {
+    "age_tc_compute_s", "age_tc_publish_s", "age_tc_display_s",
+    "age_gas_compute_s", "age_gas_publish_s", "age_gas_display_s"};
+LSTAT   agestat[NAGE];
+
+// Copies of the statistics for the page and the summary file, so that
+// their quantiles are sorted without datalock; see copy_stats()
+LSTAT   valcopy[NSTAT], chcopy[LSERVE_MAX_CH], agecopy[NAGE];
+unsigned int nvalcopy, npubcopy, pubcopy[LSERVE_MAX_VALUES];
+
+// Raw count storage
+LRAW    rawfmt;             // Count format; rawfmt.size is 0 if disabled
+#define RAWFMT  (rawfmt.size ? &rawfmt : NULL)
+volatile sig_atomic_t go_f = 1;  // Cleared to exit the main loop
+
+// Names of the values published by the server
+// These must be in the same order as value_ptrs[]
+const char* value_names[] = {
+    "plate_Thigh_C", "plate_Tlow_C", "plate_Q_kW", "plate_Tpeak_C",
+    "oxygen_scfh", "fuel_scfh", "flow_scfh", "ratio_fto",
+    "water_gph", "water_gps", "air_psig", "air_gps",
+    "cool_Thigh_C", "cool_Tlow_C", "cool_Q_kW", "standoff_in"};
+double* value_ptrs[] = {
+    &plate_Thigh_C, &plate_Tlow_C, &plate_Q_kW, &plate_Tpeak_C,
+    &oxygen_scfh, &fuel_scfh, &flow_scfh, &ratio_fto,
+    &water_gph, &water_gps, &air_psig, &air_gps,
+    &cool_Thigh_C, &cool_Tlow_C, &cool_Q_kW, &standoff_in};
+#define NVALUES (sizeof(value_names)/sizeof(char*))
+
+// Definitions used unless the configuration replaces them
+const char* default_exprs[] = {
+    "flow_scfh = oxygen_scfh + fuel_scfh",
+    "ratio_fto = fuel_scfh / oxygen_scfh"};
+#define NDEFAULT (sizeof(default_exprs)/sizeof(char*))
+
+// Published values; the derived values follow the globals above
+const char* pub_names[LSERVE_MAX_VALUES];
+double* pub_values[LSERVE_MAX_VALUES];
+unsigned int npub = 0;
+
 // Prompt for UI
 const int escape = 'p';
 const char prompt[] = "Enter a command\n"\
 "w2.7   Changes water flow rate to 2.7gph\n"\
 "a79.5  Changes air pressure to 79.5psig\n"\
 "s.275  Changes standoff height to .275in\n"\
+"t      Toggles the run statistics and writes them to the summary file\n"\
+"h      Cycles the trends through 1s, 10s, and 1min resolution and off\n"\
 "q or quit or e or exit will quit monitor.bin\n"\
 ":";
 
+// Command line help
+const char help[] = "monitor.bin [-s socket] [-p port] [-m name] [-H] [-r cpu] [-J]\n"\
+"  -s socket  Stream live data on the Unix domain socket at this path\n"\
+"  -p port    Stream live data on this TCP port on localhost\n"\
+"  -m name    Publish samples in the shared memory ring /dev/shm/name\n"\
+"  -H         Headless; run without the terminal display until SIGINT\n"\
+"  -r cpu     Run the acquisition thread SCHED_FIFO pinned to this CPU with\n"\
+"             locked memory (needs CAP_SYS_NICE)\n"\
+"  -J         Print a read jitter and backlog report on exit (implied by -r)\n";
+
 /********************************
  *                              *
  *          Prototypes          *
@@ -67,25 +253,266 @@ int get_analog(double * read_water, double * read_air, double * read_standoff);
 /* GET_TC
 .   Get thermocouple measurements.  Writes results to global variables 
 .   plate_Thigh_C, plate_Tlow_C, cool_Thigh_C, and cool_Tlow_C.
+.
+.   The stream is started by the first call after a connection and then
+.   runs continuously, so consecutive blocks are contiguous in time.  Each
+.   call reads the next block.
+.
+.   The caller holds datalock.  It is released while waiting for the block
+.   and held again before anything is changed.
+.
+.   If the stream fails or times out, the device is closed, the failure is
+.   reported to t7link, and 1 is returned.  Returns 0 on success.
 */
 int get_tc(DEVCONF* localdconf, const int devnum);
 
 
-/* COOLANT_HEAT
-.   How much heat went into the coolant.  Uses global variables air_gps, 
-.   water_gps, cool_Thigh_C, cool_Tlow_C.  Writes result to cool_Q_kW.
-* /
-int coolant_heat(void);
+/* STOP_T7
+.   Stop the T7 stream if it is running.  The next call to get_tc() starts
+.   a new one.
+*/
+void stop_t7(DEVCONF* localdconf, const int devnum);
+
+
+/* READ_GAS
+.   The gas task.  Reads the U12 meter pair with a private copy of gasmeter
+.   and stores the result with its acquisition time.  While the U12 is
+.   down, reads are only attempted when u12link allows.
+.
+.   Returns 0 on success or while waiting out a backoff, and 1 on a failed
+.   read.
+*/
+int read_gas(void* arg);
+
+
+/* REQUEST_T7
+.   Ask t7task for a reconnect attempt with a copy of the current
+.   configuration.  Does nothing if an attempt is already under way.
+*/
+void request_t7(DEVCONF* localdconf, const int devnum);
+
+
+/* RECONNECT_T7
+.   The reconnect task.  If an attempt was requested, reopen the device
+.   and upload t7conn.  The device calls can block for seconds, so they
+.   never run in the acquisition loop.
+.
+.   Returns 0 on success or when there was nothing to do and 1 on failure.
+*/
+int reconnect_t7(void* arg);
+
+
+/* COLLECT_T7
+.   Pick up the result of a reconnect attempt and report it to t7link.  On
+.   success, the new handle is adopted and the stream is restarted by the
+.   next call to get_tc().  If the configuration was reloaded during the
+.   attempt, the handle is closed and a new attempt is requested instead.
+.
+.   Returns 0 if the device was reconnected and 1 otherwise.
+*/
+int collect_t7(DEVCONF* localdconf, const int devnum);
+
+
+/* CHECK_SETTINGS
+.   Check the software settings of a configuration without applying any of
+.   them: the block size (at most NAVG_MAX), the thermocouple filter, the
+.   derived values and alarms, the trigger conditions, and the gas read
+.   rate.  The first error found is logged.  On success, filter holds the
+.   new thermocouple estimator and expr the compiled expressions, which the
+.   caller must install or free.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int check_settings(DEVCONF* localdconf, const int devnum, LROB* filter,
+                LEXPR* expr);
+
+
+/* APPLY_SETTINGS
+.   Apply the settings that only affect software: the thermocouple
+.   estimators (their counters are kept), the derived values and alarms,
+.   the gas flow offsets, the channel calibrations published by the server
+.   and the shared memory ring, and the gas read rate (flt:gas_hz).  This
+.   is called once at startup and again after each reload.
+.
+.   filter and expr are the results of CHECK_SETTINGS for the same
+.   configuration, so nothing here can fail; expr is installed as the
+.   derived values.
+*/
+void apply_settings(DEVCONF* localdconf, const int devnum, LROB* filter,
+                LEXPR* expr);
+
+
+/* READ_CONFIG
+.   Parse CONFIG_FILE after it has changed into pending and check it
+.   against the running configuration.  This runs in uitask; the file is
+.   only read while no reload is pending, so nothing it reads is changing.
+.
+.   Changes to the channel list or the raw count format change the sizes
+.   of the rings and captures, so they are rejected and need a restart.
+.   The software settings are checked by CHECK_SETTINGS into pendfilter
+.   and pendexpr, so a file with errors is rejected as a whole.
+.
+.   Rejections are recorded in the log.  Returns 0 if pending is ready to
+.   apply and 1 if the file was rejected.
+*/
+int read_config(DEVCONF* localdconf, const int devnum);
+
+
+/* RELOAD_CONFIG
+.   Apply the configuration checked by READ_CONFIG between blocks and clear
+.   reload_f.
+.
+.   Software settings (meta parameters, calibrations, labels) are applied
+.   by APPLY_SETTINGS.  Channel ranges, negative channels, resolutions,
+.   and the settling time are written directly to the affected registers.
+.   These writes and changes to nsample or samplehz stop the stream, and
+.   the next call to get_tc() restarts it with the new settings.  A failed
+.   write closes the device, and the reconnect uploads everything.  The
+.   trigger is re-initialized (after any capture in progress).
+.
+.   Every reload is recorded in the log.
+*/
+void reload_config(DEVCONF* localdconf, const int devnum);
+
+
+/* INIT_TRIGGER
+.   Configure the trigger engine from the meta parameters in the
+.   configuration file.  The trigger is disabled unless trig_pre or trig_post
+.   is set and at least one condition is given.
+.
+.       flt:trig_pre    Pre-trigger window in seconds
+.       flt:trig_post   Post-trigger window in seconds
+.       str:trig_file   Capture file prefix (default "monitor")
+.       str:trig0 ... str:trig3
+.                       Conditions of the form "channel edge level debounce"
+.                       where the level is in calibrated channel units.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int init_trigger(DEVCONF* localdconf, const int devnum);
+
+
+/* REINIT_TRIGGER
+.   Rebuild the trigger from the current configuration, keeping the count
+.   of captures.  Clears retrigger.
+*/
+void reinit_trigger(DEVCONF* localdconf, const int devnum);
+
+
+/* BUILD_EXPR
+.   Compile the derived channels and alarms from the meta parameters in the
+.   configuration file into next.  If user is 0, the meta parameters are
+.   ignored and only the default_exprs[] are compiled.
+.
+.       str:derived0 ... str:derived15
+.                       Definitions of the form "name = expression"
+.       str:alarm0 ... str:alarm15
+.                       Conditions like "ratio_fto > 2.1"; see lexpr.h
+.
+.   Expressions may use any of the value_names[], the analog inputs by
+.   index (ch0, ch1, ...) or by label, and one another.  A definition
+.   named after one of the value_names[] replaces that value.  Others are
+.   published after them.  Channels are evaluated over each block and
+.   summarized by the block mean.
+.
+.   Returns 0 on success and 1 on an error, in which case next is freed.
+*/
+int build_expr(DEVCONF* localdconf, const int devnum, LEXPR* next,
+                const int user);
+
+
+/* INSTALL_EXPR
+.   Replace the derived values and alarms with next and update the list of
+.   published values.  Alarms that are unchanged keep their state.
+*/
+void install_expr(LEXPR* next);
+
+
+/* LOG_EVENT
+.   Write a time-stamped message to the log.
+*/
+void log_event(const char* message);
+
+
+/* PUBLISH_VALUES
+.   Send the current values of the global variables and the derived
+.   channels to the server's clients in the order of pub_names[].
+*/
+void publish_values(void);
+
+
+/* INIT_STATS
+.   Name the channel statistics after the channel labels and choose the
+.   summary file: str:stat_file, or the log's name with a .stat extension.
+*/
+void init_stats(DEVCONF* localdconf, const int devnum, const char* logfile);
+
+
+/* MAP_STATS
+.   Find (or start) the statistics and history of each published value by
+.   name.  Values that disappear in a reload keep them until exit.
+*/
+void map_stats(void);
+
+
+/* UPDATE_STATS
+.   Add the current published values to their statistics and histories
+.   (stamped with tc_time).  This is called once for each block read from
+.   the T7.
+*/
+void update_stats(void);
+
+
+/* COPY_STATS
+.   Copy the run statistics into valcopy[], chcopy[], and agecopy[] and
+.   the published value rows into pubcopy[].  The caller holds datalock.
+*/
+void copy_stats(void);
+
+
+/* RECORD_AGE
+.   Add the current ages of the T7 and U12 values to their statistics for
+.   a stage (AGE_XXX).  Ages run from the sample time (tc_time, gas_time)
+.   to now.
 */
+void record_age(const unsigned int stage);
 
-/* PLATE_HEAT
-.   Calculates the heat conducted through the plate in kW and the peak plate
-.   temperature in degrees C.  PLATE_HEAT uses global variables, plate_Thigh_C, 
-.   plate_Tlow_C, cool_Thigh_C, cool_Tlow_C. It writes results to global 
-.   varaibles plate_Q_kW and plate_Tpeak_C.
-* /
-int plate_heat(void);
+
+/* WRITE_STATS
+.   Write the summary file: one line per value, channel, and age with the
+.   count, mean, standard deviation, extrema, and 1st, 50th, and 99th
+.   percentiles, followed by the sketches themselves (see lstat_write())
+.   after a ## line so that runs can be merged later (see reproc.bin -m).
+.   The statistics are copied under datalock (see COPY_STATS), and the file
+.   is written from the copies.  It is replaced atomically.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int write_stats(void);
+
+
+/* DUMP_STATS
+.   Signal handler (SIGUSR1) that asks uitask to write the summary.
+*/
+void dump_stats(int sig);
+
+
+/* HALT
+.   Signal handler that ends the main loop in headless mode.
+*/
+void halt(int sig);
+
+
+/* RUN_INTERFACE
+.   The interface task; arg is the configuration array.  Reads changes to
+.   the configuration file (see READ_CONFIG), writes the summary when asked,
+.   and, unless headless, collects commands from the keyboard without
+.   waiting for them and redraws the display.
+.
+.   Returns 0.
 */
+int run_interface(void* arg);
+
 
 /* INIT_DISPLAY
 .   This prints the parameter text and headers to the screen.  The 
@@ -101,6 +528,23 @@ void init_display(void);
 void update_display(void);
 
 
+/* INIT_STATPAGE, UPDATE_STATPAGE
+.   Draw the run statistics page in place of the values while statpage is
+.   set.  UPDATE_STATPAGE draws the copies made by COPY_STATS, so it is
+.   called without datalock.
+*/
+void init_statpage(void);
+void update_statpage(void);
+
+
+/* INIT_HISTPAGE, UPDATE_HISTPAGE
+.   Draw each published value with a sparkline of its last NSPARK history
+.   buckets and its trend at the resolution chosen by histpage.
+*/
+void init_histpage(void);
+void update_histpage(void);
+
+
 
 /********************************
  *                              *
@@ -108,68 +552,226 @@ void update_display(void);
  *                              *
  ********************************/
 
-int main(){
-    int ii, jj;
-    double ftemp;
+int main(int argc, char* argv[]){
+    int ii, opt, rawbits;
+    char logfile[LCONF_MAX_STR] = LOG_FILE;
+    double slope[LSERVE_MAX_CH], zero[LSERVE_MAX_CH], range[LSERVE_MAX_CH];
     DEVCONF dconf[1];
-    static const double orifice_mm2 = 0.4948;   // 1/32" orifice area
-    char input[INPUT_LEN];
-    char go_f = 1;
-
-	load_config(dconf, 1, CONFIG_FILE);
-    open_config(dconf,0);
-    upload_config(dconf,0);
-    
-    // Get the oxygen and fuel gas zero settings
-    if(!get_meta_flt(dconf,0,"o2offset",&ftemp))
-        LGAS_O2_OFFSET_SCFH = ftemp;
-    if(!get_meta_flt(dconf,0,"fgoffset",&ftemp))
-        LGAS_FG_OFFSET_SCFH = ftemp;
-    
-
-    
-    init_display();
-    setup_keypress();
+    char message[LEXPR_MAX_TEXT + 48];
+    char socket_path[INPUT_LEN] = "";
+    char shm_name[INPUT_LEN] = "";
+    unsigned int port = 0;
+    int rtcpu = -1, report = 0, fresh, err;
+    // LEXPR is too large for the stack
+    static LEXPR expr;
+    LROB filter;
+
+    // Parse the command line
+    while((opt = getopt(argc, argv, "s:p:m:Hr:J")) != -1){
+        switch(opt){
+            case 's':
+                strncpy(socket_path, optarg, INPUT_LEN-1);
+            break;
+            case 'p':
+                port = atoi(optarg);
+            break;
+            case 'm':
+                strncpy(shm_name, optarg, INPUT_LEN-1);
+            break;
+            case 'H':
+                headless = 1;
+            break;
+            case 'r':
+                rtcpu = atoi(optarg);
+                report = 1;
+            break;
+            case 'J':
+                report = 1;
+            break;
+            default:
+                fputs(help, stderr);
+                return -1;
+        }
+    }
+
+    if(lserve_open(&server, socket_path, port))
+        return -1;
+
+    load_config(dconf, 1, CONFIG_FILE);
+
+    // Connection gaps are appended to the log
+    get_meta_str(dconf, 0, "gap_log", logfile);
+    gaplog = fopen(logfile, "a");
+    if(gaplog == NULL)
+        fprintf(stderr, "MONITOR: Failed to open the log %s\n", logfile);
+    lsup_init(&t7link, "T7", dconf[0].samplehz, gaplog);
+    lsup_init(&u12link, "U12", 0., gaplog);
+    init_stats(dconf, 0, logfile);
+    lclock_init(&t7clock);
+
+    // If the first connection fails, keep trying in the main loop
+    if(open_config(dconf,0) || upload_config(dconf,0)){
+        close_config(dconf,0);
+        lsup_fail(&t7link, "initial connection failed");
+    }
+
+    for(ii=0; ii<dconf[0].naich && ii<LSERVE_MAX_CH; ii++){
+        slope[ii] = dconf[0].aich[ii].calslope;
+        zero[ii] = dconf[0].aich[ii].calzero;
+        range[ii] = dconf[0].aich[ii].range;
+    }
+
+    // Keep raw ADC counts in the rings and captures instead of doubles?
+    if(!get_meta_int(dconf, 0, "rawbits", &rawbits) &&
+            lraw_init(&rawfmt, ii, range, rawbits))
+        return -1;
+
+    if(shm_name[0] && lshm_open(&ring, shm_name, ii,
+            SHM_SECONDS * dconf[0].samplehz, dconf[0].samplehz, slope, zero,
+            RAWFMT))
+        return -1;
+
+    if(init_trigger(dconf, 0))
+        return -1;
+
+    lsched_mutex_init(&datalock);
+    lsched_init(&uitask, "interface", UI_HZ, run_interface, dconf);
+    lsched_exclude(&uitask, rtcpu);
+
+    lsched_mutex_init(&t7lock);
+    lsched_init(&t7task, "T7 reconnect", RECONNECT_HZ, reconnect_t7, NULL);
+    lsched_exclude(&t7task, rtcpu);
+
+    lgas_init(&gasmeter);
+    lsched_mutex_init(&gaslock);
+    lsched_init(&gastask, "gas", GAS_HZ, read_gas, NULL);
+    // Keep the gas task off the acquisition CPU
+    lsched_exclude(&gastask, rtcpu);
+    if(check_settings(dconf, 0, &filter, &expr)){
+        fprintf(stderr, "MONITOR: Invalid settings in %s; see %s\n",
+                CONFIG_FILE, logfile);
+        return -1;
+    }
+    apply_settings(dconf, 0, &filter, &expr);
+
+    // Reload the configuration when it is saved
+    lwatch_open(&confwatch, CONFIG_FILE);
+
+    // The summary can be written at any time without stopping
+    signal(SIGUSR1, dump_stats);
+    if(headless){
+        signal(SIGINT, halt);
+        signal(SIGTERM, halt);
+    }else{
+        // The display is drawn into the buffer under datalock and written
+        // to the terminal after it is released
+        setvbuf(stdout, NULL, _IOFBF, OUTBUF_LEN);
+        setup_keypress();
+    }
+
+    // The tasks keep normal scheduling, so they start before the
+    // acquisition thread enters real-time mode
+    if(lsched_start(&gastask) || lsched_start(&t7task) ||
+            lsched_start(&uitask))
+        go_f = 0;
+
+    // Every buffer is allocated by now; the real-time mode locks them all
+    else if(report && lrt_init(&rtstat, 0))
+        go_f = 0;
+    else if(rtcpu >= 0 && lrt_enter(&rtstat, rtcpu, 0))
+        go_f = 0;
+    err = !go_f;
+
+    pthread_mutex_lock(&datalock);
     while(go_f){
-        // Get gas flow rates
-        get_gas(&oxygen_scfh, &fuel_scfh);
-        // Update the flow and ratio calculations
-        flow_scfh = oxygen_scfh + fuel_scfh;
-        ratio_fto = fuel_scfh / oxygen_scfh;
-
-		// Get thermocouples
-		get_tc(dconf, 0);
-
-        // User input?
-        if(prompt_on_keypress(escape,prompt,input,INPUT_LEN)){
-            switch(input[0]){
-                case 'w':
-                    if(sscanf(&input[1],"%lf",&water_gph)==1)
-                        water_gps = 1.05139 * water_gph;
-                break;
-                case 'a':
-                    if(sscanf(&input[1],"%lf",&air_psig)==1)
-                        air_gps = (air_psig + 14.7) * 0.015907485 * orifice_mm2;
-                break;
-                case 's':
-                    sscanf(&input[1],"%lf",&standoff_in);
-                break;
-                case 'q':
-                case 'e':
-                    go_f = 0;
-                break;
-            }
-            // Redraw the display
-            init_display();
+        // Accept new clients and decimation requests
+        lserve_service(&server);
+
+        // Apply configuration changes between blocks
+        if(reload_f)
+            reload_config(dconf, 0);
+        if(retrigger && trigger.out == NULL)
+            reinit_trigger(dconf, 0);
+
+        // Get the latest gas flow rates from the gas task
+        // Both flows come from the same reading
+        pthread_mutex_lock(&gaslock);
+        oxygen_scfh = gas_o2_scfh;
+        fuel_scfh = gas_fg_scfh;
+        gas_time = gas_stamp;
+        u12snap = u12link;
+        pthread_mutex_unlock(&gaslock);
+
+        // Get thermocouples
+        // The stream paces the loop; while the T7 is down, pause instead
+        // and leave the reconnect attempts to t7task
+        fresh = 0;
+        if(!t7link.up)
+            collect_t7(dconf, 0);
+        if(t7link.up)
+            fresh = !get_tc(dconf, 0);
+        else{
+            if(lsup_ready(&t7link))
+                request_t7(dconf, 0);
+            pthread_mutex_unlock(&datalock);
+            usleep(IDLE_US);
+            pthread_mutex_lock(&datalock);
         }
+        // Update the heat balances
+        lheat_plate(plate_Thigh_C, plate_Tlow_C, cool_Tlow_C, cool_Thigh_C,
+                &plate_Q_kW, &plate_Tpeak_C);
+        lheat_coolant(air_gps, water_gps, cool_Tlow_C, cool_Thigh_C,
+                &cool_Q_kW);
+        // Update the derived values, including the flow and ratio, and the
+        // alarms
+        lexpr_eval(&derived);
+        record_age(AGE_COMPUTE);
+        // Alarms are logged with the age of the block that set them
+        for(ii=0; ii<derived.neq; ii++)
+            if(derived.eq[ii].changed){
+                sprintf(message, "alarm %s: %s (sampled %.3fs ago)",
+                        derived.eq[ii].active ? "on" : "cleared",
+                        derived.eq[ii].text, lclock_now() - tc_time);
+                log_event(message);
+            }
 
-        // Finally, update the output values
-        update_display();
+        // Send the latest values to any clients
+        publish_values();
+        record_age(AGE_PUBLISH);
+        // Values are only counted once per block
+        if(fresh)
+            update_stats();
     }
+    pthread_mutex_unlock(&datalock);
 
-    finish_keypress();
-    close_config(dconf, 0);
-    return 0;
+    lsched_stop(&uitask);
+    if(!headless){
+        finish_keypress();
+        fflush(stdout);
+    }
+    lsched_stop(&gastask);
+    lsched_stop(&t7task);
+    // An attempt that finished after the loop has a handle to close
+    if(t7state == T7_OPEN)
+        close_config(t7conn, 0);
+    write_stats();
+    if(t7link.up){
+        stop_t7(dconf, 0);
+        close_config(dconf, 0);
+    }
+    if(gaplog)
+        fclose(gaplog);
+    lwatch_close(&confwatch);
+    lserve_close(&server);
+    ltrig_free(&trigger);
+    lshm_close(&ring);
+    lexpr_free(&derived);
+    if(reload_f)
+        lexpr_free(&pendexpr);
+    if(report)
+        lrt_report(&rtstat, stdout);
+    lrt_free(&rtstat);
+    return err ? -1 : 0;
 }
 
 /*
@@ -198,40 +800,811 @@ int get_analog(double * read_water, double * read_air, double * read_standoff){
 
 //******************************************************************************
 int get_tc(DEVCONF* localdconf, const int devnum){
+    static double work[NAVG_MAX];
     double *data=NULL;
-    double Tamb, V[4], T[4];
-    unsigned int ii, jj, channels, samples_per_read;
+    double Tamb, V[NTC], T[NTC], deadline, now;
+    unsigned int jj, channels, samples_per_read;
+    const char* reason = NULL;
+
+    // The stream runs continuously; it is only started after a connection,
+    // a failure, or a reload that changed it
+    if(!t7stream){
+        lclock_start(&t7clock, localdconf[devnum].samplehz, lclock_now());
+        if(start_data_stream(localdconf,devnum,-1))
+            reason = "stream start failed";
+        else
+            t7stream = 1;
+        // The samples before the gap are not pre-trigger data
+        if(trigger.ncond)
+            ltrig_break(&trigger);
+    }
 
     // Collect raw thermocouple voltages
-    // This is a blocking operation!
-    start_data_stream(localdconf,devnum,-1);
-    while(data==NULL){
-		service_data_stream(localdconf,devnum);
-		read_data_stream(localdconf,devnum, &data, &channels, &samples_per_read);
-	}
-    stop_data_stream(localdconf,devnum);
+    // This is a blocking operation, but it gives up after READ_TIMEOUT.
+    // Only this thread uses the stream, so uitask may have datalock
+    // meanwhile.
+    pthread_mutex_unlock(&datalock);
+    deadline = lclock_now() + READ_TIMEOUT;
+    if(localdconf[devnum].samplehz > 0.)
+        deadline += localdconf[devnum].nsample / localdconf[devnum].samplehz;
+    while(data==NULL && reason==NULL){
+        if(service_data_stream(localdconf,devnum))
+            reason = "stream service failed";
+        else if(read_data_stream(localdconf,devnum, &data, &channels, &samples_per_read))
+            reason = "stream read failed";
+        else if(data==NULL && lclock_now() > deadline)
+            reason = "stream read timed out";
+    }
+    now = lclock_now();
+    pthread_mutex_lock(&datalock);
+    if(reason){
+        stop_t7(localdconf,devnum);
+        close_config(localdconf,devnum);
+        lsup_fail(&t7link, reason);
+        return 1;
+    }
+    lclock_read(&t7clock, samples_per_read, now);
+    // Scans already waiting on the device by the fitted clock
+    lrt_block(&rtstat, lclock_backlog(&t7clock, now));
+    // Values reduced from the block are stamped at its middle sample
+    tc_time = lclock_host(&t7clock, t7clock.index - 0.5*(samples_per_read + 1));
+    // Stream the raw block straight out of the acquisition buffer
+    lserve_send_block(&server, data, channels, samples_per_read);
+    lshm_write_at(&ring, data, samples_per_read, lclock_wall(&t7clock,
+            lclock_host(&t7clock, t7clock.index - samples_per_read)),
+            t7clock.period);
+    // Only triggered windows are written to disk
+    if(trigger.ncond)
+        ltrig_block(&trigger, data, samples_per_read);
+    lexpr_block(&derived, data, channels, samples_per_read);
+    for(jj=0; jj<channels && jj<nchstat; jj++)
+        lstat_block(&chstat[jj], &data[jj], channels, samples_per_read,
+                localdconf[devnum].aich[jj].calslope,
+                localdconf[devnum].aich[jj].calzero);
 
     // Get the approximate ambient temperature
-    LJM_eReadName(localdconf[devnum].handle, "TEMPERATURE_AIR_K", &Tamb);
+    // Registers can be read while the stream runs
+    if(LJM_eReadName(localdconf[devnum].handle, "TEMPERATURE_AIR_K", &Tamb)){
+        stop_t7(localdconf,devnum);
+        close_config(localdconf,devnum);
+        lsup_fail(&t7link, "ambient temperature read failed");
+        return 1;
+    }
 
-    // Average the tiny voltages and convert to temperature
-    for(jj=0; jj<4; jj++){
-        for(ii=0; ii<localdconf[devnum].nsample; ii++)
-            V[jj] += data[ii*4+jj];
-        V[jj]/=localdconf[devnum].nsample;
-        LJM_TCVoltsToTemp(LJM_ttK, V[jj], Tamb, &T[jj]);
-        T[jj] -= 273.15;    // convert to C
+    // Reduce the tiny voltages with spike rejection and convert to 
+    // temperature with the T7's ambient sensor as the cold junction
+    // check_settings() keeps nsample within NAVG_MAX; this only guards work
+    if(samples_per_read > NAVG_MAX)
+        samples_per_read = NAVG_MAX;
+    for(jj=0; jj<NTC; jj++){
+        V[jj] = lrob_estimate(&tcfilter[jj], &data[jj], channels,
+                samples_per_read, work);
+        T[jj] = ltc_k_t(V[jj], Tamb - 273.15);
     }
     // Map the respective temperatures to their appropriate values
     plate_Thigh_C = T[0];
     plate_Tlow_C = T[1];
     cool_Thigh_C = T[2];
     cool_Tlow_C = T[3];
+    return 0;
+}
+
+
+//*****************************************************************************
+void stop_t7(DEVCONF* localdconf, const int devnum){
+    if(t7stream)
+        stop_data_stream(localdconf,devnum);
+    t7stream = 0;
+}
+
+
+//*****************************************************************************
+int read_gas(void* arg){
+    LGAS gas;
+    LSUP link;
+    double o2, fg, start, stamp;
+    int err;
+
+    // Only this task changes u12link, so it works on a copy.  The lock is
+    // only held to copy values in and out; the U12 read and the gap log
+    // writes are done without it.
+    pthread_mutex_lock(&gaslock);
+    link = u12link;
+    gas = gasmeter;
+    pthread_mutex_unlock(&gaslock);
+    if(!link.up && !lsup_ready(&link))
+        return 0;
+
+    start = lclock_now();
+    err = lgas_get(&gas, &o2, &fg);
+    // Stamp the reading at the middle of the two channel reads
+    stamp = 0.5 * (start + lclock_now());
+    if(err)
+        lsup_fail(&link, "gas flow read failed");
+    else
+        lsup_restored(&link);
+
+    pthread_mutex_lock(&gaslock);
+    gasmeter.u12_id = gas.u12_id;
+    u12link = link;
+    if(!err){
+        gas_o2_scfh = o2;
+        gas_fg_scfh = fg;
+        gas_stamp = stamp;
+    }
+    pthread_mutex_unlock(&gaslock);
+    return err;
+}
+
+
+//*****************************************************************************
+void request_t7(DEVCONF* localdconf, const int devnum){
+    pthread_mutex_lock(&t7lock);
+    if(t7state == T7_IDLE){
+        t7conn[0] = localdconf[devnum];
+        t7reloads = reloads;
+        t7state = T7_WANTED;
+    }
+    pthread_mutex_unlock(&t7lock);
+}
+
+
+//*****************************************************************************
+int reconnect_t7(void* arg){
+    int state, err;
+
+    pthread_mutex_lock(&t7lock);
+    state = t7state;
+    pthread_mutex_unlock(&t7lock);
+    if(state != T7_WANTED)
+        return 0;
+
+    err = open_config(t7conn,0) || upload_config(t7conn,0);
+    if(err)
+        close_config(t7conn,0);
+
+    pthread_mutex_lock(&t7lock);
+    t7state = err ? T7_FAILED : T7_OPEN;
+    pthread_mutex_unlock(&t7lock);
+    return err;
+}
+
+
+//*****************************************************************************
+int collect_t7(DEVCONF* localdconf, const int devnum){
+    int state;
+
+    pthread_mutex_lock(&t7lock);
+    state = t7state;
+    if(state == T7_OPEN || state == T7_FAILED)
+        t7state = T7_IDLE;
+    pthread_mutex_unlock(&t7lock);
+
+    if(state == T7_FAILED){
+        lsup_fail(&t7link, "reconnect failed");
+        return 1;
+    }else if(state != T7_OPEN)
+        return 1;
+    // The registers uploaded are out of date; try again with the new ones
+    if(t7reloads != reloads){
+        close_config(t7conn,0);
+        request_t7(localdconf, devnum);
+        return 1;
+    }
+    localdconf[devnum].handle = t7conn[0].handle;
+    lsup_restored(&t7link);
+    return 0;
 }
 
 
+//*****************************************************************************
+int init_trigger(DEVCONF* localdconf, const int devnum){
+    double pre_s = 0., post_s = 0.;
+    double slope[LTRIG_MAX_CH], zero[LTRIG_MAX_CH];
+    char prefix[LCONF_MAX_STR] = CAPTURE_FILE;
+    char spec[LCONF_MAX_STR], param[16];
+    unsigned int ii, channels;
+
+    memset(&trigger, 0, sizeof(LTRIG));
+    get_meta_flt(localdconf, devnum, "trig_pre", &pre_s);
+    get_meta_flt(localdconf, devnum, "trig_post", &post_s);
+    get_meta_str(localdconf, devnum, "trig_file", prefix);
+    if(pre_s <= 0. && post_s <= 0.)
+        return 0;
+
+    channels = localdconf[devnum].naich;
+    for(ii=0; ii<channels && ii<LTRIG_MAX_CH; ii++){
+        slope[ii] = localdconf[devnum].aich[ii].calslope;
+        zero[ii] = localdconf[devnum].aich[ii].calzero;
+    }
+    if(ltrig_init(&trigger, channels,
+            (unsigned int)(pre_s * localdconf[devnum].samplehz),
+            (unsigned int)(post_s * localdconf[devnum].samplehz),
+            prefix, CONFIG_FILE, RAWFMT))
+        return 1;
+
+    for(ii=0; ii<LTRIG_MAX_COND; ii++){
+        sprintf(param, "trig%u", ii);
+        if(!get_meta_str(localdconf, devnum, param, spec) &&
+                ltrig_parse(&trigger, spec, slope, zero))
+            return 1;
+    }
+    return 0;
+}
+
+//*****************************************************************************
+void reinit_trigger(DEVCONF* localdconf, const int devnum){
+    unsigned int nevents;
+
+    nevents = trigger.nevents;
+    ltrig_free(&trigger);
+    if(init_trigger(localdconf, devnum))
+        log_event("reload: trigger disabled by a configuration error");
+    trigger.nevents = nevents;
+    retrigger = 0;
+}
+
+//*****************************************************************************
+int check_settings(DEVCONF* localdconf, const int devnum, LROB* filter,
+                LEXPR* expr){
+    // LTRIG is too large for the stack
+    static LTRIG trig;
+    double slope[LTRIG_MAX_CH], zero[LTRIG_MAX_CH];
+    double tcreject = 0., tctrim = 0., gas_hz = GAS_HZ;
+    double pre_s = 0., post_s = 0.;
+    char tcmode[LCONF_MAX_STR] = "mad";
+    char spec[LCONF_MAX_STR], param[16];
+    unsigned int ii;
+    int err = 0;
+
+    // The thermocouple estimators only have room for NAVG_MAX samples
+    if(localdconf[devnum].nsample > NAVG_MAX){
+        log_event("settings rejected: nsample is larger than NAVG_MAX");
+        return 1;
+    }
+    get_meta_str(localdconf, devnum, "tcfilter", tcmode);
+    get_meta_flt(localdconf, devnum, "tcreject", &tcreject);
+    get_meta_flt(localdconf, devnum, "tctrim", &tctrim);
+    if(lrob_init(filter, tcmode, tcreject, tctrim)){
+        log_event("settings rejected: invalid thermocouple filter");
+        return 1;
+    }
+    get_meta_flt(localdconf, devnum, "gas_hz", &gas_hz);
+    if(!(gas_hz > 0.)){
+        log_event("settings rejected: gas_hz must be positive");
+        return 1;
+    }
+
+    // The trigger conditions are parsed on a trigger with no ring
+    get_meta_flt(localdconf, devnum, "trig_pre", &pre_s);
+    get_meta_flt(localdconf, devnum, "trig_post", &post_s);
+    if(pre_s > 0. || post_s > 0.){
+        for(ii=0; ii<localdconf[devnum].naich && ii<LTRIG_MAX_CH; ii++){
+            slope[ii] = localdconf[devnum].aich[ii].calslope;
+            zero[ii] = localdconf[devnum].aich[ii].calzero;
+        }
+        memset(&trig, 0, sizeof(LTRIG));
+        err = ltrig_init(&trig, localdconf[devnum].naich, 0, 0,
+                CAPTURE_FILE, NULL, NULL);
+        for(ii=0; ii<LTRIG_MAX_COND && !err; ii++){
+            sprintf(param, "trig%u", ii);
+            err = !get_meta_str(localdconf, devnum, param, spec) &&
+                    ltrig_parse(&trig, spec, slope, zero);
+        }
+        ltrig_free(&trig);
+        if(err){
+            log_event("settings rejected: invalid trigger condition");
+            return 1;
+        }
+    }
+
+    // The expressions are compiled last, so nothing is left to free on
+    // the errors above.  At startup there are none to keep, so bad ones
+    // are replaced by the defaults rather than stopping the monitor.
+    if(build_expr(localdconf, devnum, expr, 1)){
+        if(derived.compiled){
+            log_event("settings rejected: invalid derived value or alarm");
+            return 1;
+        }
+        fprintf(stderr, "MONITOR: Invalid derived values or alarms in %s; "
+                "using the defaults\n", CONFIG_FILE);
+        log_event("startup: invalid derived values or alarms; defaults used");
+        if(build_expr(localdconf, devnum, expr, 0))
+            return 1;
+    }
+    return 0;
+}
+
+//*****************************************************************************
+void apply_settings(DEVCONF* localdconf, const int devnum, LROB* filter,
+                LEXPR* expr){
+    double slope[LSERVE_MAX_CH], zero[LSERVE_MAX_CH];
+    double ftemp, gas_hz = GAS_HZ;
+    unsigned int ii;
+
+    // The value names are sent to clients with the calibrations
+    install_expr(expr);
+
+    // Clients receive the channel calibrations and value names on connection
+    for(ii=0; ii<localdconf[devnum].naich && ii<LSERVE_MAX_CH; ii++){
+        slope[ii] = localdconf[devnum].aich[ii].calslope;
+        zero[ii] = localdconf[devnum].aich[ii].calzero;
+    }
+    lserve_set_cal(&server, ii, slope, zero);
+    lshm_update(&ring, localdconf[devnum].samplehz, slope, zero);
+
+    // Get the oxygen and fuel gas zero settings and the read rate
+    pthread_mutex_lock(&gaslock);
+    if(!get_meta_flt(localdconf,devnum,"o2offset",&ftemp))
+        gasmeter.o2_offset_scfh = ftemp;
+    if(!get_meta_flt(localdconf,devnum,"fgoffset",&ftemp))
+        gasmeter.fg_offset_scfh = ftemp;
+    pthread_mutex_unlock(&gaslock);
+    get_meta_flt(localdconf, devnum, "gas_hz", &gas_hz);
+    lsched_rate(&gastask, gas_hz);
+
+    t7link.samplehz = localdconf[devnum].samplehz;
+
+    // Configure the thermocouple spike rejection
+    for(ii=0; ii<NTC; ii++){
+        filter->accepted = tcfilter[ii].accepted;
+        filter->rejected = tcfilter[ii].rejected;
+        tcfilter[ii] = *filter;
+    }
+}
+
+//*****************************************************************************
+int read_config(DEVCONF* localdconf, const int devnum){
+    AICONF *old, *new;
+    unsigned int ii;
+    int oldbits = 0, newbits = 0;
+
+    if(load_config(pending, 1, CONFIG_FILE)){
+        log_event("reload rejected: the file could not be parsed");
+        return 1;
+    }
+
+    // Changes to the shape of the data need a restart
+    get_meta_int(localdconf, devnum, "rawbits", &oldbits);
+    get_meta_int(pending, 0, "rawbits", &newbits);
+    if(pending[0].naich != localdconf[devnum].naich){
+        log_event("reload rejected: the channel count changed");
+        return 1;
+    }else if(oldbits != newbits){
+        log_event("reload rejected: rawbits changed");
+        return 1;
+    }
+    for(ii=0; ii<pending[0].naich; ii++){
+        old = &localdconf[devnum].aich[ii];
+        new = &pending[0].aich[ii];
+        if(new->channel != old->channel){
+            log_event("reload rejected: a channel number changed");
+            return 1;
+        }else if(newbits && new->range != old->range){
+            // The count scale follows the range
+            log_event("reload rejected: a range changed with rawbits set");
+            return 1;
+        }
+    }
+    // The software settings are checked now and applied with the rest
+    if(check_settings(pending, 0, &pendfilter, &pendexpr)){
+        log_event("reload rejected: invalid settings");
+        return 1;
+    }
+    return 0;
+}
+
+//*****************************************************************************
+void reload_config(DEVCONF* localdconf, const int devnum){
+    AICONF *old, *new;
+    char reg[LCONF_MAX_STR], message[LCONF_MAX_STR];
+    unsigned int ii, writes = 0;
+    int err = 0, changed;
+
+    // The stream is restarted with a new rate or block size.  Registers
+    // are only written while it is stopped.
+    changed = pending[0].samplehz != localdconf[devnum].samplehz ||
+            pending[0].nsample != localdconf[devnum].nsample ||
+            pending[0].settleus != localdconf[devnum].settleus;
+    for(ii=0; ii<pending[0].naich; ii++){
+        old = &localdconf[devnum].aich[ii];
+        new = &pending[0].aich[ii];
+        changed |= new->range != old->range ||
+                new->nchannel != old->nchannel ||
+                new->resolution != old->resolution;
+    }
+    if(changed)
+        stop_t7(localdconf, devnum);
+
+    // Write only the registers that changed.  If the device is down, the
+    // reconnect uploads the whole new configuration instead.
+    for(ii=0; ii<pending[0].naich && t7link.up; ii++){
+        old = &localdconf[devnum].aich[ii];
+        new = &pending[0].aich[ii];
+        if(new->range != old->range){
+            sprintf(reg, "AIN%u_RANGE", new->channel);
+            err |= LJM_eWriteName(localdconf[devnum].handle, reg, new->range);
+            writes++;
+        }
+        if(new->nchannel != old->nchannel){
+            sprintf(reg, "AIN%u_NEGATIVE_CH", new->channel);
+            err |= LJM_eWriteName(localdconf[devnum].handle, reg, new->nchannel);
+            writes++;
+        }
+        if(new->resolution != old->resolution){
+            sprintf(reg, "AIN%u_RESOLUTION_INDEX", new->channel);
+            err |= LJM_eWriteName(localdconf[devnum].handle, reg, new->resolution);
+            writes++;
+        }
+    }
+    if(t7link.up && pending[0].settleus != localdconf[devnum].settleus){
+        err |= LJM_eWriteName(localdconf[devnum].handle, "STREAM_SETTLING_US",
+                pending[0].settleus);
+        writes++;
+    }
+
+    // Adopt the new configuration, but keep the connection
+    memcpy(localdconf[devnum].aich, pending[0].aich, sizeof(pending[0].aich));
+    memcpy(localdconf[devnum].meta, pending[0].meta, sizeof(pending[0].meta));
+    localdconf[devnum].samplehz = pending[0].samplehz;
+    localdconf[devnum].nsample = pending[0].nsample;
+    localdconf[devnum].settleus = pending[0].settleus;
+    if(err){
+        // The reconnect will upload everything
+        close_config(localdconf, devnum);
+        lsup_fail(&t7link, "register write failed during reload");
+    }
+    apply_settings(localdconf, devnum, &pendfilter, &pendexpr);
+    if(trigger.out)
+        retrigger = 1;
+    else
+        reinit_trigger(localdconf, devnum);
+
+    reload_f = 0;
+    reloads++;
+    sprintf(message, "reload applied with %u register writes", writes);
+    log_event(message);
+}
+
+//*****************************************************************************
+int build_expr(DEVCONF* localdconf, const int devnum, LEXPR* next,
+                const int user){
+    char spec[LCONF_MAX_STR], param[16];
+    unsigned int ii, length;
+    int index;
+    AICONF* ain;
+
+    lexpr_init(next, localdconf[devnum].nsample ?
+            localdconf[devnum].nsample : NAVG_MAX);
+    for(ii=0; ii<NVALUES; ii++)
+        lexpr_scalar(next, value_names[ii], value_ptrs[ii]);
+    // Labels that are not valid names are only available by index
+    for(ii=0; ii<localdconf[devnum].naich; ii++){
+        ain = &localdconf[devnum].aich[ii];
+        sprintf(param, "ch%u", ii);
+        lexpr_channel(next, param, ii, ain->calslope, ain->calzero);
+        if(ain->label[0])
+            lexpr_channel(next, ain->label, ii, ain->calslope, ain->calzero);
+    }
+    for(ii=0; ii<NEXPR && user; ii++){
+        sprintf(param, "derived%u", ii);
+        if(!get_meta_str(localdconf, devnum, param, spec) &&
+                lexpr_derived(next, spec)){
+            lexpr_free(next);
+            return 1;
+        }
+    }
+    for(ii=0; ii<NDEFAULT; ii++){
+        length = strcspn(default_exprs[ii], " =");
+        memcpy(spec, default_exprs[ii], length);
+        spec[length] = '\0';
+        index = lexpr_find(next, spec);
+        if(index < 0 || next->var[index].kind != LEXPR_DERIVED)
+            lexpr_derived(next, default_exprs[ii]);
+    }
+    for(ii=0; ii<NEXPR && user; ii++){
+        sprintf(param, "alarm%u", ii);
+        if(!get_meta_str(localdconf, devnum, param, spec) &&
+                lexpr_alarm(next, spec)){
+            lexpr_free(next);
+            return 1;
+        }
+    }
+    if(lexpr_compile(next)){
+        lexpr_free(next);
+        return 1;
+    }
+    return 0;
+}
+
+//*****************************************************************************
+void install_expr(LEXPR* next){
+    unsigned int ii, jj;
+
+    // Alarms that are unchanged keep their state and event counts
+    for(ii=0; ii<next->neq; ii++)
+        for(jj=0; next->eq[ii].out < 0 && jj<derived.neq; jj++)
+            if(derived.eq[jj].out < 0 &&
+                    strcmp(next->eq[ii].text, derived.eq[jj].text)==0){
+                next->eq[ii].active = derived.eq[jj].active;
+                next->eq[ii].events = derived.eq[jj].events;
+            }
+    lexpr_free(&derived);
+    derived = *next;
+
+    // Publish the derived values that are not already globals
+    for(npub=0; npub<NVALUES; npub++){
+        pub_names[npub] = value_names[npub];
+        pub_values[npub] = value_ptrs[npub];
+    }
+    for(ii=0; ii<derived.nvar && npub<LSERVE_MAX_VALUES; ii++)
+        if(derived.var[ii].kind == LEXPR_DERIVED && derived.var[ii].bind == NULL){
+            pub_names[npub] = derived.var[ii].name;
+            pub_values[npub++] = &derived.var[ii].value;
+        }
+    lserve_set_names(&server, npub, pub_names);
+    map_stats();
+}
+
+//*****************************************************************************
+void log_event(const char* message){
+    char stamp[32];
+    if(gaplog == NULL)
+        return;
+    lsup_time(time(NULL), stamp, sizeof(stamp));
+    fprintf(gaplog, "%s %s\n", stamp, message);
+    fflush(gaplog);
+}
+
+//*****************************************************************************
+void publish_values(void){
+    double values[LSERVE_MAX_VALUES];
+    unsigned int ii;
+    for(ii=0; ii<npub; ii++)
+        values[ii] = *pub_values[ii];
+    lserve_send_values(&server, values, npub);
+}
+
+//*****************************************************************************
+void init_stats(DEVCONF* localdconf, const int devnum, const char* logfile){
+    char* ext;
+    unsigned int ii;
+
+    nchstat = localdconf[devnum].naich < LSERVE_MAX_CH ?
+            localdconf[devnum].naich : LSERVE_MAX_CH;
+    for(ii=0; ii<nchstat; ii++){
+        if(localdconf[devnum].aich[ii].label[0])
+            lstat_name(chnames[ii], localdconf[devnum].aich[ii].label);
+        else
+            sprintf(chnames[ii], "ch%u", ii);
+        lstat_init(&chstat[ii]);
+    }
+    for(ii=0; ii<NAGE; ii++)
+        lstat_init(&agestat[ii]);
+
+    // The summary goes next to the log unless it is configured
+    if(get_meta_str(localdconf, devnum, "stat_file", statfile)){
+        strncpy(statfile, logfile, LCONF_MAX_STR-6);
+        statfile[LCONF_MAX_STR-6] = '\0';
+        ext = strrchr(statfile, '.');
+        if(ext && !strchr(ext, '/'))
+            *ext = '\0';
+        strcat(statfile, ".stat");
+    }
+}
+
+//*****************************************************************************
+void map_stats(void){
+    unsigned int ii, jj;
+    char name[LSTAT_MAX_STR];
+
+    for(ii=0; ii<npub; ii++){
+        lstat_name(name, pub_names[ii]);
+        for(jj=0; jj<nstat && strcmp(statnames[jj], name); jj++);
+        if(jj == nstat && nstat < NSTAT){
+            strcpy(statnames[nstat], name);
+            lhist_init(&history[nstat], NULL);
+            lstat_init(&valstat[nstat++]);
+        }
+        // NSTAT means the value is not tracked
+        pub_stat[ii] = jj;
+    }
+}
+
+//*****************************************************************************
+void update_stats(void){
+    unsigned int ii;
+    for(ii=0; ii<npub; ii++)
+        if(pub_stat[ii] < NSTAT){
+            lstat_add(&valstat[pub_stat[ii]], *pub_values[ii]);
+            lhist_add(&history[pub_stat[ii]], tc_time, *pub_values[ii]);
+        }
+}
+
+//*****************************************************************************
+void copy_stats(void){
+    unsigned int ii;
+    // Names are only ever added, so the copies share them
+    for(ii=0; ii<nstat; ii++)
+        valcopy[ii] = valstat[ii];
+    nvalcopy = nstat;
+    for(ii=0; ii<npub; ii++)
+        pubcopy[ii] = pub_stat[ii];
+    npubcopy = npub;
+    for(ii=0; ii<nchstat; ii++)
+        chcopy[ii] = chstat[ii];
+    for(ii=0; ii<NAGE; ii++)
+        agecopy[ii] = agestat[ii];
+}
+
+//*****************************************************************************
+void record_age(const unsigned int stage){
+    double now = lclock_now();
+    if(tc_time > 0.)
+        lstat_add(&agestat[stage], now - tc_time);
+    if(gas_time > 0.)
+        lstat_add(&agestat[NAGE/2 + stage], now - gas_time);
+}
+
+//*****************************************************************************
+// Write one row of the summary table
+static void write_stat_row(FILE* ff, const char* name, const LSTAT* st){
+    static const double q[] = {0.01, 0.5, 0.99};
+    double p[3];
+    lstat_quantiles(st, q, 3, p);
+    fprintf(ff, "%-24s %12llu %12.6g %12.6g %12.6g %12.6g %12.6g %12.6g %12.6g\n",
+            name, st->n, st->mean, lstat_std(st), st->min, st->max,
+            p[0], p[1], p[2]);
+}
+
+//*****************************************************************************
+int write_stats(void){
+    char temp[LCONF_MAX_STR + 8], stamp[32];
+    unsigned int ii;
+    FILE* ff;
+    int err;
+
+    pthread_mutex_lock(&datalock);
+    copy_stats();
+    pthread_mutex_unlock(&datalock);
+
+    sprintf(temp, "%s.tmp", statfile);
+    ff = fopen(temp, "w");
+    if(ff == NULL){
+        fprintf(stderr, "WRITE_STATS: Failed to open %s\n", temp);
+        return 1;
+    }
+    lsup_time(time(NULL), stamp, sizeof(stamp));
+    fprintf(ff, "# monitor.bin run statistics %s\n", stamp);
+    fprintf(ff, "#%-23s %12s %12s %12s %12s %12s %12s %12s %12s\n", "name",
+            "n", "mean", "std", "min", "max", "p1", "p50", "p99");
+    for(ii=0; ii<nvalcopy; ii++)
+        write_stat_row(ff, statnames[ii], &valcopy[ii]);
+    for(ii=0; ii<nchstat; ii++)
+        write_stat_row(ff, chnames[ii], &chcopy[ii]);
+    for(ii=0; ii<NAGE; ii++)
+        write_stat_row(ff, age_names[ii], &agecopy[ii]);
+    fprintf(ff, "##\n");
+    err = 0;
+    for(ii=0; ii<nvalcopy; ii++)
+        err = err || lstat_write(ff, statnames[ii], &valcopy[ii]);
+    for(ii=0; ii<nchstat; ii++)
+        err = err || lstat_write(ff, chnames[ii], &chcopy[ii]);
+    for(ii=0; ii<NAGE; ii++)
+        err = err || lstat_write(ff, age_names[ii], &agecopy[ii]);
+    if(fclose(ff) || err || rename(temp, statfile)){
+        fprintf(stderr, "WRITE_STATS: Failed to write %s\n", statfile);
+        remove(temp);
+        return 1;
+    }
+    return 0;
+}
+
+//*****************************************************************************
+void dump_stats(int sig){
+    dump_f = 1;
+}
+
+//*****************************************************************************
+void halt(int sig){
+    go_f = 0;
+}
+
+//*****************************************************************************
+int run_interface(void* arg){
+    DEVCONF* localdconf = arg;
+    static char input[INPUT_LEN];
+    int waiting;
+
+    // A changed file is read here, without datalock, and applied by the
+    // acquisition loop between blocks
+    pthread_mutex_lock(&datalock);
+    waiting = reload_f;
+    pthread_mutex_unlock(&datalock);
+    if(!waiting && lwatch_changed(&confwatch) && !read_config(localdconf, 0)){
+        pthread_mutex_lock(&datalock);
+        reload_f = 1;
+        pthread_mutex_unlock(&datalock);
+    }
+    if(dump_f){
+        dump_f = 0;
+        write_stats();
+    }
+
+    // Skip the display and user prompt when running headless
+    if(headless)
+        return 0;
+
+    // User input?
+    // The loop keeps running while a command is typed
+    if(poll_prompt(escape,prompt,input,INPUT_LEN,&typed)){
+        pthread_mutex_lock(&datalock);
+        switch(input[0]){
+            case 'w':
+                if(sscanf(&input[1],"%lf",&water_gph)==1)
+                    water_gps = lheat_water_gps(water_gph);
+            break;
+            case 'a':
+                if(sscanf(&input[1],"%lf",&air_psig)==1)
+                    air_gps = lheat_air_gps(air_psig);
+            break;
+            case 's':
+                sscanf(&input[1],"%lf",&standoff_in);
+            break;
+            case 't':
+                statpage = !statpage;
+                histpage = 0;
+                dump_f = 1;
+            break;
+            case 'h':
+                histpage = (histpage + 1) % (LHIST_LEVELS + 1);
+                statpage = 0;
+            break;
+            case 'q':
+            case 'e':
+                go_f = 0;
+            break;
+        }
+        pthread_mutex_unlock(&datalock);
+        redraw = 1;
+    }
+    // Leave the prompt alone until the command is entered
+    if(typed >= 0)
+        return 0;
+
+    // Update the output values
+    // The derived values and alarms on the display change with a reload
+    pthread_mutex_lock(&datalock);
+    if(redraw || drawn != reloads){
+        init_display();
+        redraw = 0;
+        drawn = reloads;
+    }
+    if(statpage)
+        copy_stats();
+    else
+        update_display();
+    record_age(AGE_DISPLAY);
+    pthread_mutex_unlock(&datalock);
+    // The quantiles are sorted from the copies
+    if(statpage)
+        update_statpage();
+    fflush(stdout);
+    return 0;
+}
+
 //*****************************************************************************
 void init_display(void){
+    char label[LEXPR_MAX_STR];
+    unsigned int ii, row, nalarm = 0;
+
+    if(statpage){
+        init_statpage();
+        return;
+    }else if(histpage){
+        init_histpage();
+        return;
+    }
     clear_terminal();
 
     // Column 1: Temperature Measurements
@@ -248,6 +1621,17 @@ void init_display(void){
     print_param(11,COL1,"Water (gps)");
     print_param(12,COL1,"Air (gps)");
     print_bparam(13,COL1,"Heat (kW)");
+    print_param(14,COL1,"TC Spikes");
+    //  Derived values and alarms from the configuration
+    print_header(16,1,"Derived Values and Alarms");
+    row = 17;
+    for(ii=NVALUES; ii<npub && row<17+NDISP; ii++)
+        print_param(row++,COL1,pub_names[ii]);
+    for(ii=0; ii<derived.neq && row<17+NDISP; ii++)
+        if(derived.eq[ii].out < 0){
+            sprintf(label, "Alarm %u", nalarm++);
+            print_param(row++,COL1,label);
+        }
 
     // Column 2: Torch Measurements
     //  Gas flow rates
@@ -261,10 +1645,30 @@ void init_display(void){
     print_param(9,COL2,"Water (GPH)");
     print_param(10,COL2,"Air (PSIG)");
     print_param(11,COL2,"Standoff (in)");
+    print_param(12,COL2,"Captures");
+    print_param(13,COL2,"Reloads");
+
+    print_header(14,40,"Connections");
+    print_param(15,COL2,"T7");
+    print_param(16,COL2,"U12");
+    print_param(17,COL2,"Gaps");
+    print_param(18,COL2,"Last Gap (s)");
+    print_param(19,COL2,"Gas Age (s)");
+    print_param(20,COL2,"TC Age (s)");
+    print_param(21,COL2,"T7 Drift (ppm)");
+    print_param(22,COL2,"T7 Start (ms)");
 }
 
 //*****************************************************************************
 void update_display(void){
+    char status[32];
+    unsigned int ii, row;
+    double now;
+
+    if(histpage){
+        update_histpage();
+        return;
+    }
 
     // Column 1: Temperature Measurements
     //  Plate temperature group
@@ -278,6 +1682,21 @@ void update_display(void){
     print_flt(11,COL1,water_gps);
     print_flt(12,COL1,air_gps);
     print_bflt(13,COL1,cool_Q_kW);
+    print_int(14,COL1,tcfilter[0].rejected + tcfilter[1].rejected +
+            tcfilter[2].rejected + tcfilter[3].rejected);
+    //  Derived values and alarms, in the order of init_display()
+    row = 17;
+    for(ii=NVALUES; ii<npub && row<17+NDISP; ii++)
+        print_flt(row++,COL1,*pub_values[ii]);
+    for(ii=0; ii<derived.neq && row<17+NDISP; ii++)
+        if(derived.eq[ii].out < 0){
+            sprintf(status, "%s (%lu)", derived.eq[ii].active ? "ACTIVE" : "ok",
+                    derived.eq[ii].events);
+            if(derived.eq[ii].active)
+                print_bstr(row++,COL1,status);
+            else
+                print_str(row++,COL1,status);
+        }
 
     // Column 2: Torch Measurements
     //  Gas flow rates
@@ -289,83 +1708,107 @@ void update_display(void){
     print_flt(9,COL2,water_gph);
     print_flt(10,COL2,air_psig);
     print_flt(11,COL2,standoff_in);
+    print_int(12,COL2,trigger.nevents);
+    print_int(13,COL2,reloads);
 
-    LDISP_CGO(15,1);
-    fflush(stdout);
+    // Show how long a device has been down
+    if(t7link.up)
+        print_str(15,COL2,"OK");
+    else{
+        sprintf(status, "DOWN %.0fs", lsup_downtime(&t7link));
+        print_bstr(15,COL2,status);
+    }
+    if(u12snap.up)
+        print_str(16,COL2,"OK");
+    else{
+        sprintf(status, "DOWN %.0fs", lsup_downtime(&u12snap));
+        print_bstr(16,COL2,status);
+    }
+    print_int(17,COL2,t7link.ngaps + u12snap.ngaps);
+    print_flt(18,COL2,t7link.last_gap > u12snap.last_gap ?
+            t7link.last_gap : u12snap.last_gap);
+    // How old are the values on the screen?
+    now = lclock_now();
+    print_flt(19,COL2,gas_time > 0. ? now - gas_time : NAN);
+    print_flt(20,COL2,tc_time > 0. ? now - tc_time : NAN);
+    // The sample clock fit; the start delay bounds the stamp error
+    print_flt(21,COL2,lclock_drift(&t7clock));
+    print_flt(22,COL2,t7clock.streams ? 1e3*t7clock.startup : NAN);
+
+    LDISP_CGO(18+NDISP,1);
 }
 
-/*
 //*****************************************************************************
-int coolant_heat(void){
-    double  Thigh_K,        // High temperature in K
-            Tlow_K,         // Low temperature in K
-            water_vap1_gps, // The water vapor flow rate at the inlet
-            water_vap2_gps, // The water vapor flow rate at the outlet
-            dh1,            // Latent enthalpy at the inlet
-            dh2,            // Latent enthalpy at the outlet
-            xv1,            // Vapor mole fraction at the inlet
-            xv2,            // Vapor mole fraction at the outlet
-            Q;              // The result; heat
-    // estimates for inlet and outlet total pressures in MPa
-    static const double ptot1 = 0.13586, ptot2 = 0.101325;
-    // molar weights for water and air
-    static const double ww = 18.015, wa = 28.97;
-    // specific heat of liquid water and air in J/g/K
-    static const double cpw = 4.182, cpa = 1.005;
-    
-    // Convert the units
-
-    // Go from C to K
-    Tlow_K = cool_Tlow_C + 273.15;
-    Thigh_K = cool_Thigh_C + 273.15;
-
-    // Latent heats in J/g
-    dh1 = latent(Tlow_K);
-    dh2 = latent(Thigh_K);
-    // d-less partial pressures
-    xv1 = psat(Tlow_K)/ptot1;
-    xv2 = psat(Thigh_K)/ptot2;
-
-    // If we're below the triple point or above the critical point
-    // Something is VERY VERY WRONG
-    if(xv1<0 || xv2<0) return -1.;
-    // If the temperature has exceeded the saturation temperature at this pressure
-    // The estimate will be rough
-    if(xv1 >= 1.) water_vap1_gps = water_gps;
-    else water_vap1_gps = air_gps * (ww / wa) * xv1 / (1. - xv1);
-
-    if(xv2 >= 1.) water_vap2_gps = water_gps;
-    else water_vap2_gps = air_gps * (ww / wa) * xv2 / (1. - xv2);
-
-    // Check to see if all the water is vapor.  This can happen at low water 
-    // flow rates
-    if(water_vap1_gps > water_gps) water_vap1_gps = water_gps;
-    if(water_vap2_gps > water_gps) water_vap2_gps = water_gps;
-
-    Q = (air_gps*cpa + water_gps*cpw)*(Thigh_K - Tlow_K) + \
-        water_vap2_gps * dh2 - water_vap1_gps * dh1;
-
-    // Convert to kJ
-    cool_Q_kW = .001 * Q;
-    return 0;
+void init_statpage(void){
+    char line[128];
+    clear_terminal();
+    sprintf(line, "Run Statistics (%s)", statfile);
+    print_header(2,1,line);
+    sprintf(line, "%-24s %10s %10s %10s %10s %10s %10s %10s %10s", "",
+            "n", "mean", "std", "min", "max", "p1", "p50", "p99");
+    print_text(3,1,line);
 }
-*/
 
-/*
 //*****************************************************************************
-int plate_heat(void){
-    double dT, n, th, tl, Tc;
-    // Nominal temperature drop across the plate
-    dT = 1.4556 * (plate_Thigh_C - plate_Tlow_C);
-    Tc = 0.5*(cool_Tlow_C + cool_Thigh_C);
-    // dimensionless high and low temperatures
-    th = (plate_Thigh_C - Tc)/dT;
-    tl = (plate_Tlow_C - Tc)/dT;
-    // dimensionless plate conductivity
-    n = 1. + (1.894*plate_Tlow_C - 1.207*plate_Thigh_C)/\
-            (1.0032*plate_Thigh_C - 1.0005*plate_Tlow_C);
-    plate_Tpeak_C = (3.903 + n)*dT + Tc;
-    plate_Q_kW = .0042 * dT;
-    return 0;
+// One row of the statistics page
+static void print_stat_row(const unsigned int row, const char* name,
+                const LSTAT* st){
+    static const double q[] = {0.01, 0.5, 0.99};
+    char line[128];
+    double p[3];
+    lstat_quantiles(st, q, 3, p);
+    sprintf(line, "%-24s %10llu %10.4g %10.4g %10.4g %10.4g %10.4g %10.4g %10.4g",
+            name, st->n, st->mean, lstat_std(st), st->min, st->max,
+            p[0], p[1], p[2]);
+    print_text(row,1,line);
+}
+
+//*****************************************************************************
+void update_statpage(void){
+    unsigned int ii, row = 4;
+    // The published values, the channels, then the ages
+    for(ii=0; ii<npubcopy; ii++)
+        if(pubcopy[ii] < NSTAT)
+            print_stat_row(row++, statnames[pubcopy[ii]], &valcopy[pubcopy[ii]]);
+    for(ii=0; ii<nchstat; ii++)
+        print_stat_row(row++, chnames[ii], &chcopy[ii]);
+    for(ii=0; ii<NAGE; ii++)
+        print_stat_row(row++, age_names[ii], &agecopy[ii]);
+    LDISP_CGO(row+1,1);
+}
+
+//*****************************************************************************
+void init_histpage(void){
+    char line[64];
+    double period;
+    unsigned int ii, row = 4;
+
+    clear_terminal();
+    // Every history has the same periods
+    period = history[0].period[histpage-1];
+    sprintf(line, "Trends (%gs per column, last %gmin)", period,
+            period * NSPARK / 60.);
+    print_header(2,1,line);
+    print_text(3,COL1+18+NSPARK+2,"Rate (per min)");
+    for(ii=0; ii<npub; ii++)
+        if(pub_stat[ii] < NSTAT)
+            print_param(row++,COL1,pub_names[ii]);
+}
+
+//*****************************************************************************
+void update_histpage(void){
+    double mean[NSPARK];
+    unsigned int ii, row = 4, index;
+
+    for(ii=0; ii<npub; ii++){
+        index = pub_stat[ii];
+        if(index >= NSTAT)
+            continue;
+        lhist_series(&history[index], histpage-1, NULL, mean, NULL, NSPARK);
+        print_flt(row,COL1,*pub_values[ii]);
+        print_spark(row,COL1+18,mean,NSPARK);
+        print_trend(row++,COL1+18+NSPARK+2,mean,NSPARK,
+                history[index].period[histpage-1]);
+    }
+    LDISP_CGO(row+1,1);
 }
-*/
@@ -94,7 +94,7 @@ double latent(const double T){
     static const double D2 = -0.18598945532374373e-3;
     double t;
 
-    t = (T - D2)/D0;
+    t = (T - D0)/D2;
     return (sqrt(b*b + 4.*t) - b)/2.;
 }
 
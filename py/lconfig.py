@@ -4,9 +4,28 @@
 import os, sys
 import numpy as np
 import json
+import time
+import fnmatch
+import sqlite3
+import multiprocessing
 import matplotlib.pyplot as plt
 
-__version__ = '3.04'
+__version__ = '3.05'
+
+# Channels with more samples than this are shown as min/max envelopes
+ENVELOPE_THRESHOLD = 100000
+
+# Number of spectral segments transformed at a time; bounds memory use
+SPECTRAL_BATCH = 256
+
+# Use a compiled multi-threaded FFT when one is available
+try:
+    import scipy.fft
+    def _rfft(x):
+        return scipy.fft.rfft(x, axis=-1, workers=-1)
+except ImportError:
+    def _rfft(x):
+        return np.fft.rfft(x, axis=-1)
 
 
 
@@ -45,7 +64,9 @@ word = read_pair(ff)
             if charin == '#':
                 # Rewind by two characters so the read param algorithm
                 # will stick on the ## character combination
-                ff.seek(-2,1)
+                # Text files do not allow relative seeks in Python 3,
+                # so seek to an absolute position instead.
+                ff.seek(ff.tell()-2)
                 return param
             # Kill off the remainder of the line
             while charin and charin!='\n':
@@ -209,6 +230,23 @@ LE2 = LEnum(LE)
             return
         raise Exception('LE setstate: State is out-of-range: %d'%ind)
 
+def _get_window(window, nfft):
+    """Return a periodic window array of length nfft"""
+    if isinstance(window, str):
+        window = window.lower()
+        if window in ('hann', 'hanning'):
+            return np.hanning(nfft+1)[:-1]
+        elif window == 'hamming':
+            return np.hamming(nfft+1)[:-1]
+        elif window in ('boxcar', 'rect', 'none'):
+            return np.ones(nfft)
+        raise Exception('Unrecognized window: %s'%window)
+    window = np.asarray(window, dtype=float)
+    if window.shape != (nfft,):
+        raise Exception('The window must have nfft elements')
+    return window
+
+
 ###
 # Default dictionaries
 ###
@@ -320,6 +358,11 @@ is not intended for direct access.  Instead, use the get() function.
         self.data = None
         self.cal = cal
         self.filename = os.path.abspath(filename)
+        # Envelope pyramids cached by show_channel()
+        self._envelope = {}
+        # Raw count scale and offset; None unless the file holds counts
+        self._rawscale = None
+        self._rawoffset = None
 
         with open(filename,'r') as ff:
             
@@ -417,15 +460,33 @@ is not intended for direct access.  Instead, use the get() function.
             # Read in the date/timestamp
             self.timestamp = ff.readline()
             
+            # Raw count files store integers; their calibration is 
+            # deferred until get_channel() is called
+            meta = self._devconf[0]['meta']
+            if 'rawbits' in meta:
+                convert = int
+                naich = len(self._devconf[0]['aich'])
+                self._rawscale = np.array(
+                        [meta.get('rawscale%d'%ii, 1.) for ii in range(naich)])
+                self._rawoffset = np.array(
+                        [meta.get('rawoffset%d'%ii, 0.) for ii in range(naich)])
+            else:
+                convert = float
+            
             # Read in the data
             thisline = ff.readline()
             while thisline:
-                self.data.append([float(this) for this in thisline.split()])
+                self.data.append([convert(this) for this in thisline.split()])
                 thisline = ff.readline()
-            self.data = np.array(self.data)
+            
+            if self._rawscale is not None:
+                self.data = np.array(self.data, 
+                        dtype=np.int16 if meta['rawbits'] <= 16 else np.int32)
+            else:
+                self.data = np.array(self.data)
             
             # Apply the calibrations?
-            if cal:
+            if cal and self._rawscale is None:
                 # Calculate the calibrated data
                 for aich in range(len(self._devconf[0]['aich'])):
                     temp = self.get(0, 'aicalzero', aich=aich)
@@ -586,7 +647,8 @@ The same rules apply for the analog output and fio channels.
             default = DEF_FIOCH
             
         # If the recall is multiple    
-        if hasattr(param, '__iter__'):
+        # Strings are iterable in Python 3, so test for them explicitly
+        if hasattr(param, '__iter__') and not isinstance(param, str):
             out = []
             for pp in param:
                 if pp in source:
@@ -606,6 +668,18 @@ The same rules apply for the analog output and fio channels.
             raise Exception('Unrecognized parameter: %s'%param)
 
 
+    def _calibrate(self, x, aich):
+        """Convert raw counts from channel aich to (calibrated) values"""
+        x = x * self._rawscale[aich] + self._rawoffset[aich]
+        if self.cal:
+            temp = self.get(0, 'aicalzero', aich=aich)
+            if temp != 0.:
+                x -= temp
+            temp = self.get(0, 'aicalslope', aich=aich)
+            if temp != 1.:
+                x *= temp
+        return x
+
     def get_channel(self, aich, downsample=None, start=None, stop=None):
         """Retrieve data from channel aich
     x = get_channel(aich)
@@ -616,6 +690,10 @@ channel with a matching label will be returned.
 
 X is the numpy array containing data for the requested channel.
 
+If the file holds raw ADC counts (int:rawbits), the "data" member is an
+integer array of counts.  get_channel() converts only the samples that
+are requested to volts and applies the calibration to them.
+
 Optional keyword parameters are
 
 DOWNSAMPLE
@@ -651,9 +729,13 @@ neither, one, or both of these parameters.
                 I1 = self._get_index(stop)
             if downsample is not None:
                 I2 = int(downsample+1)
-            return self.data[I0:I1:I2, aich]
-            
-        return self.data[:,aich]
+            x = self.data[I0:I1:I2, aich]
+        else:
+            x = self.data[:,aich]
+        
+        if self._rawscale is not None:
+            return self._calibrate(x, aich)
+        return x
 
     def get_time(self, downsample=None, start=None, stop=None):
         """Retrieve a time vector corresponding to the channel data
@@ -684,7 +766,7 @@ an exception
 
     def show_channel(self, aich, ax=None, fig=None, downsample=None, 
             show=True, ylabel=None, xlabel=None, fs=16,
-            start=None, stop=None,
+            start=None, stop=None, envelope=None,
             plot_param={}):
         """Plot the data from a channel
     mpll = show_channel(aich)
@@ -706,7 +788,16 @@ will be created.
 
 DOWNSAMPLE
 This parameter is passed to get_time() and get_channel() to reduce the 
-size of the dataset shown.
+size of the dataset shown.  Stride decimation can hide spikes; the
+envelope option is usually a better choice.
+
+ENVELOPE
+If True, the channel is drawn as a min/max envelope (see the lplot 
+Envelope class) with one minimum and maximum per pixel column.  Peaks 
+are kept exactly, and the envelope is recomputed from a cached 
+multi-resolution summary whenever the axes are zoomed or panned.  If 
+None, the envelope is used when the channel has more than 
+ENVELOPE_THRESHOLD samples and no downsample is given.
 
 SHOW
 If True, then a non-blocking show() command will be called after 
@@ -753,11 +844,27 @@ command to configure the line object.
         else:
             aicalunits = 'V'
             
-        # Get data and time
-        t = self.get_time(downsample=downsample, start=start, stop=stop)
-        y = self.get_channel(aich, downsample=downsample, start=start, stop=stop)
+        if envelope is None:
+            envelope = not downsample and self.ndata() > ENVELOPE_THRESHOLD
         
-        ll = ax.plot(t, y, label=ailabel, **plot_param)
+        if envelope:
+            import lplot
+            # The pyramid spans the whole channel so that panning works
+            if aich not in self._envelope:
+                self._envelope[aich] = lplot.Envelope(
+                        self.get_time(), self.get_channel(aich))
+            ll = [lplot.plot_envelope(ax, None, None, 
+                    envelope=self._envelope[aich], label=ailabel, 
+                    **plot_param)]
+            if start is not None or stop is not None:
+                t = self.get_time()
+                ax.set_xlim(t[0] if start is None else start, 
+                        t[-1] if stop is None else stop)
+        else:
+            # Get data and time
+            t = self.get_time(downsample=downsample, start=start, stop=stop)
+            y = self.get_channel(aich, downsample=downsample, start=start, stop=stop)
+            ll = ax.plot(t, y, label=ailabel, **plot_param)
         
         if xlabel:
             ax.set_xlabel(xlabel, fontsize=fs)
@@ -878,4 +985,440 @@ This is done by y.
                 
             test_last = test
         return indices
+
+
+
+    def _spectral(self, aich, nfft, overlap, window, start, stop, detrend):
+        """Generator for the spectral methods
+    for index, power in _spectral(...):
+
+Yields batches of at most SPECTRAL_BATCH segments at a time.  INDEX is
+an array of the sample index at the center of each segment, and POWER
+is a (segments x nfft//2+1) array of the one-sided power spectral 
+density of each segment in units**2/Hz.  Only one batch is ever held in
+memory.
+"""
+        fs = self.get(0, 'samplehz')
+        nfft = int(nfft)
+        step = nfft - int(round(overlap * nfft))
+        if step < 1 or step > nfft:
+            raise Exception('Overlap must be in the range [0,1).')
+        w = _get_window(window, nfft)
+        # Density scaling; double all but DC and Nyquist for one-sided
+        scale = np.full(nfft//2+1, 2./(fs*np.sum(w*w)))
+        scale[0] /= 2.
+        if nfft%2 == 0:
+            scale[-1] /= 2.
+        
+        if self.data is None:
+            raise Exception('This LConf object does not have channel data.')
+        if isinstance(aich,str):
+            aich = self._get_label(0, 'aich', aich)
+        i0 = 0 if start is None else self._get_index(start)
+        i1 = self.ndata() if stop is None else self._get_index(stop)
+        # Slice before calibrating; raw counts are converted one batch at
+        # a time
+        y = self.data[i0:i1, aich]
+        nseg = (y.size - nfft)//step + 1
+        if nseg < 1:
+            raise Exception('The selection is shorter than nfft=%d samples'%nfft)
+        
+        for first in range(0, nseg, SPECTRAL_BATCH):
+            count = min(SPECTRAL_BATCH, nseg-first)
+            x = y[first*step : first*step + (count-1)*step + nfft]
+            if self._rawscale is not None:
+                x = self._calibrate(x, aich)
+            # Strided view of the overlapping segments; no copy until the
+            # window is applied
+            seg = np.lib.stride_tricks.as_strided(
+                    x, shape=(count, nfft), 
+                    strides=(step*x.strides[0], x.strides[0]))
+            if detrend:
+                seg = seg - seg.mean(axis=1, keepdims=True)
+            X = _rfft(seg * w)
+            power = (X.real**2 + X.imag**2) * scale
+            index = i0 + (first + np.arange(count))*step + nfft//2
+            yield index, power
+
+    def get_psd(self, aich, nfft=1024, overlap=0.5, window='hann', 
+            start=None, stop=None, detrend=True):
+        """Estimate the power spectral density of a channel by Welch's method
+    f, P = get_psd(aich, nfft=1024, overlap=0.5, window='hann')
+    
+F is the frequency array in Hz, and P is the one-sided power spectral 
+density in (calibrated units)**2/Hz.  AICH is the same index or label
+accepted by get_channel().
+
+NFFT
+The segment length in samples.  The frequency resolution is 
+samplehz/nfft.
+
+OVERLAP
+The fraction of each segment shared with the next (0 <= overlap < 1).
+
+WINDOW
+'hann', 'hamming', 'boxcar', or an array of nfft window weights.
+
+START, STOP
+Time selection in seconds; identical to get_channel().
+
+DETREND
+If True, the mean of each segment is removed before transforming.
+
+The segments are transformed in batches of SPECTRAL_BATCH, so memory use
+does not grow with the length of the record.
+"""
+        fs = self.get(0, 'samplehz')
+        total = np.zeros(int(nfft)//2+1)
+        count = 0
+        for index, power in self._spectral(aich, nfft, overlap, window, 
+                start, stop, detrend):
+            total += power.sum(axis=0)
+            count += power.shape[0]
+        return np.fft.rfftfreq(int(nfft), 1./fs), total/count
+        
+    def get_spectrogram(self, aich, nfft=1024, overlap=0.5, window='hann',
+            start=None, stop=None, detrend=True, navg=1):
+        """Calculate a spectrogram of a channel
+    t, f, S = get_spectrogram(aich, nfft=1024, overlap=0.5, window='hann',
+            navg=1)
+    
+T is the array of times (s) at the center of each column, F is the 
+frequency array (Hz), and S is a (len(t) x len(f)) array of power 
+spectral densities.  The keywords are the same as get_psd().
+
+NAVG
+The number of consecutive segments averaged into each column of S.  
+Larger values reduce both the variance and the size of the result for
+long records.
+"""
+        fs = self.get(0, 'samplehz')
+        navg = max(int(navg), 1)
+        times = []
+        columns = []
+        # Carry partial averages across batch boundaries
+        acc = np.zeros(int(nfft)//2+1)
+        tacc = 0.
+        nacc = 0
+        for index, power in self._spectral(aich, nfft, overlap, window, 
+                start, stop, detrend):
+            for ii in range(power.shape[0]):
+                acc += power[ii]
+                tacc += index[ii]
+                nacc += 1
+                if nacc == navg:
+                    columns.append(acc/nacc)
+                    times.append(tacc/nacc/fs)
+                    acc = np.zeros_like(acc)
+                    tacc = 0.
+                    nacc = 0
+        if nacc:
+            columns.append(acc/nacc)
+            times.append(tacc/nacc/fs)
+        return np.array(times), np.fft.rfftfreq(int(nfft), 1./fs), np.array(columns)
+        
+    def get_bandpower(self, aich, bands, nfft=1024, overlap=0.5, 
+            window='hann', start=None, stop=None, detrend=True):
+        """Calculate a time series of the power in frequency bands
+    t, P = get_bandpower(aich, bands, nfft=1024, overlap=0.5, window='hann')
+
+BANDS is a list of (low, high) frequency pairs in Hz.  T is the array 
+of segment center times (s), and P is a (len(t) x len(bands)) array of
+the power in each band in (calibrated units)**2.  The keywords are the
+same as get_psd().
+    t, P = LC.get_bandpower('T1', [(55., 65.), (115., 125.)])
+"""
+        fs = self.get(0, 'samplehz')
+        f = np.fft.rfftfreq(int(nfft), 1./fs)
+        df = fs / int(nfft)
+        masks = np.array([(f >= low) & (f < high) for low, high in bands], 
+                dtype=float).T
+        times = []
+        out = []
+        for index, power in self._spectral(aich, nfft, overlap, window, 
+                start, stop, detrend):
+            times.append(index/fs)
+            out.append(power.dot(masks) * df)
+        return np.concatenate(times), np.concatenate(out)
+
+
+###
+# Collection indexing
+###
+
+def _index_value(value):
+    """Split a parameter value into its numeric and string forms for the 
+index.  Returns a (num, str) tuple; either may be None."""
+    if isinstance(value, LEnum):
+        return value.getvalue(), value.get()
+    elif isinstance(value, (int, float)):
+        return value, None
+    return None, str(value)
+
+
+def _index_file(args):
+    """Parse the header of a single data file for the collection index
+    path, mtime, size, timestamp, epoch, ndata, header, rows, error = \
+            _index_file((path, mtime, size))
+
+This is run in worker processes by LCollection.refresh().  Only the
+configuration header is parsed.  The samples are counted by scanning
+for line breaks, but they are never converted to floats.
+"""
+    path, mtime, size = args
+    timestamp = ''
+    epoch = None
+    ndata = 0
+    try:
+        LC = LConf(path, data=False)
+        
+        with open(path, 'rb') as ff:
+            # Find the end-of-config marker
+            thisline = ff.readline()
+            while thisline and not thisline.startswith(b'##'):
+                thisline = ff.readline()
+            timestamp = ff.readline().decode(errors='replace').strip()
+            # Count the data lines in large chunks
+            chunk = ff.read(1<<20)
+            last = b'\n'
+            while chunk:
+                ndata += chunk.count(b'\n')
+                last = chunk[-1:]
+                chunk = ff.read(1<<20)
+            if last != b'\n':
+                ndata += 1
+        try:
+            epoch = time.mktime(time.strptime(timestamp, '%a %b %d %H:%M:%S %Y'))
+        except ValueError:
+            pass
+        
+        # Gather the device and meta parameters
+        rows = []
+        for devnum in range(LC.ndev()):
+            for param in DEF_DEV:
+                num, txt = _index_value(LC.get(devnum, param))
+                rows.append((devnum, param, num, txt))
+            for param,value in LC._devconf[devnum]['meta'].items():
+                num, txt = _index_value(value)
+                rows.append((devnum, param, num, txt))
+            rows.append((devnum, 'naich', LC.naich(devnum), None))
+        rows.append((0, 'ndata', ndata, None))
+        rows.append((0, 'epoch', epoch, None))
+        return path, mtime, size, timestamp, epoch, ndata, str(LC), rows, None
+    except Exception as err:
+        return path, mtime, size, timestamp, epoch, ndata, '', [], repr(err)
+
+
+class LCollection:
+    """Laboratory data collection class
+
+The LCollection class maintains a persistent index of the LConfig data 
+files in a directory tree so that large groups of captures can be 
+searched without re-parsing them.  The index is an SQLite file that 
+holds each file's configuration header, device parameters, meta 
+parameters, timestamp, and sample count.
+
+    C = LCollection('/path/to/data')
+    
+On creation (and whenever refresh() is called) the tree is walked, and 
+only files that are new or whose size or modification time has changed
+are parsed.  Parsing is spread across a pool of worker processes.  
+Files that have disappeared are removed from the index.
+
+The index is written to '.lcollection.db' in the root directory unless 
+the INDEX keyword is given.  The PATTERN keyword selects the data files
+(default '*.dat'), and PROCESSES sets the worker pool size (default is 
+one per CPU).
+    C = LCollection('/path/to/data', index='/tmp/data.db', pattern='*.txt')
+
+Files are selected with query().  Keywords name device or meta 
+parameters; see query() for the selection rules.
+    paths = C.query(o2offset=(0.09,None), samplehz=1000)
+
+In addition to the configuration parameters, each file has 'naich' 
+(number of analog inputs), 'ndata' (number of samples), and 'epoch' 
+(the data timestamp in seconds since the epoch).
+
+The collection also behaves like a list of the indexed file paths, in 
+timestamp order.
+    len(C)
+    C[0]
+    
+Individual files can be summarized or loaded
+    C.get(path)         Returns a dictionary of indexed parameters
+    C.load(path)        Returns an LConf object with data loaded
+"""
+    def __init__(self, root, index=None, pattern='*.dat', processes=None, 
+            refresh=True):
+        self.root = os.path.abspath(root)
+        self.pattern = pattern
+        self.processes = processes
+        if index is None:
+            index = os.path.join(self.root, '.lcollection.db')
+        self.index = os.path.abspath(index)
+        self._db = sqlite3.connect(self.index)
+        self._db.executescript("""
+CREATE TABLE IF NOT EXISTS files (
+    path TEXT PRIMARY KEY, mtime REAL, size INTEGER, timestamp TEXT,
+    epoch REAL, ndata INTEGER, header TEXT, error TEXT);
+CREATE TABLE IF NOT EXISTS params (
+    path TEXT, devnum INTEGER, name TEXT, num REAL, str TEXT);
+CREATE INDEX IF NOT EXISTS params_num ON params (name, num);
+CREATE INDEX IF NOT EXISTS params_str ON params (name, str);
+CREATE INDEX IF NOT EXISTS params_path ON params (path);
+""")
+        if refresh:
+            self.refresh()
+            
+    def __len__(self):
+        return self._db.execute(
+                'SELECT COUNT(*) FROM files WHERE error IS NULL').fetchone()[0]
+    
+    def __getitem__(self, item):
+        paths = [this[0] for this in self._db.execute(
+                'SELECT path FROM files WHERE error IS NULL ORDER BY epoch, path')]
+        return paths[item]
+    
+    def refresh(self, verbose=False):
+        """Bring the index up to date with the directory tree
+    updated, removed = refresh(verbose=False)
+    
+Returns the number of files that were (re-)parsed and the number that
+were removed from the index.  If VERBOSE is True, each parsed file is
+printed along with any error encountered.
+"""
+        known = {}
+        for path, mtime, size in self._db.execute(
+                'SELECT path, mtime, size FROM files'):
+            known[path] = (mtime, size)
+        
+        # Find new and modified files
+        stale = []
+        found = set()
+        for dirpath, dirnames, filenames in os.walk(self.root):
+            for name in fnmatch.filter(filenames, self.pattern):
+                path = os.path.join(dirpath, name)
+                try:
+                    st = os.stat(path)
+                except OSError:
+                    continue
+                found.add(path)
+                if known.get(path) != (st.st_mtime, st.st_size):
+                    stale.append((path, st.st_mtime, st.st_size))
+        removed = [path for path in known if path not in found]
+        
+        # Parse the stale files in parallel
+        results = []
+        if len(stale) > 1 and self.processes != 1:
+            pool = multiprocessing.Pool(self.processes)
+            try:
+                results = pool.map(_index_file, stale, 
+                        chunksize=max(1, len(stale)//(8*multiprocessing.cpu_count())))
+            finally:
+                pool.close()
+                pool.join()
+        else:
+            results = [_index_file(this) for this in stale]
+        
+        # Commit the results in a single transaction
+        with self._db:
+            for path in removed:
+                self._db.execute('DELETE FROM files WHERE path=?', (path,))
+                self._db.execute('DELETE FROM params WHERE path=?', (path,))
+            for path, mtime, size, timestamp, epoch, ndata, header, rows, error in results:
+                if verbose:
+                    sys.stdout.write('%s %s\n'%(path, error if error else ''))
+                self._db.execute('DELETE FROM params WHERE path=?', (path,))
+                self._db.execute(
+                        'INSERT OR REPLACE INTO files VALUES (?,?,?,?,?,?,?,?)',
+                        (path, mtime, size, timestamp, epoch, ndata, header, error))
+                self._db.executemany(
+                        'INSERT INTO params VALUES (?,?,?,?,?)',
+                        [(path,) + row for row in rows])
+        return len(results), len(removed)
+        
+    def query(self, devnum=0, **kwarg):
+        """Select files by their parameter values
+    paths = query(devnum=0, param=value, ...)
+    
+Returns a list of file paths, in timestamp order, for which every 
+condition is true on device DEVNUM.  The selection rules are
+    param=value         param equals value (number or string)
+    param=(value,)      param does not equal value
+    param=(low,high)    low <= param <= high
+    param=(high,low)    param < low OR param > high, when high > low
+Either limit of a range may be None for a one-sided test.
+    C.query(o2offset=(0.09,None), samplehz=1000)
+    C.query(connection='eth', ndata=(10000,None))
+"""
+        sql = 'SELECT path FROM files WHERE error IS NULL'
+        args = []
+        for param, value in kwarg.items():
+            sub = ' AND path IN (SELECT path FROM params WHERE name=? AND devnum=? AND '
+            args += [param, devnum]
+            if isinstance(value, tuple) and len(value) == 1:
+                sub += '(%s IS NULL OR %s!=?))'
+                value = value[0]
+                column = 'str' if isinstance(value, str) else 'num'
+                sub = sub%(column, column)
+                args.append(value)
+            elif isinstance(value, tuple) and len(value) == 2:
+                low, high = value
+                if low is not None and high is not None and low > high:
+                    sub += '(num<? OR num>?))'
+                    args += [high, low]
+                elif low is None and high is None:
+                    sub += 'num IS NOT NULL)'
+                elif low is None:
+                    sub += 'num<=?)'
+                    args.append(high)
+                elif high is None:
+                    sub += 'num>=?)'
+                    args.append(low)
+                else:
+                    sub += 'num BETWEEN ? AND ?)'
+                    args += [low, high]
+            elif isinstance(value, str):
+                sub += 'str=?)'
+                args.append(value)
+            else:
+                sub += 'num=?)'
+                args.append(value)
+            sql += sub
+        sql += ' ORDER BY epoch, path'
+        return [this[0] for this in self._db.execute(sql, args)]
+        
+    def get(self, path, devnum=0):
+        """Return a dictionary of the indexed parameters for a file
+    params = get(path, devnum=0)
+    
+The 'header' and 'timestamp' keys hold the formatted configuration and 
+the raw timestamp string.
+"""
+        path = os.path.abspath(path)
+        row = self._db.execute(
+                'SELECT timestamp, header FROM files WHERE path=?', 
+                (path,)).fetchone()
+        if row is None:
+            raise Exception('LCOLLECTION: File is not indexed: %s'%path)
+        out = {'timestamp':row[0], 'header':row[1]}
+        for name, num, txt in self._db.execute(
+                'SELECT name, num, str FROM params WHERE path=? AND devnum=?',
+                (path, devnum)):
+            out[name] = txt if txt is not None else num
+        return out
+        
+    def load(self, path, cal=True):
+        """Load a file's data
+    LC = load(path, cal=True)
+"""
+        return LConf(path, data=True, cal=cal)
+        
+    def errors(self):
+        """Return a list of (path, error) for files that failed to parse"""
+        return list(self._db.execute(
+                'SELECT path, error FROM files WHERE error IS NOT NULL'))
         
+    def close(self):
+        """Close the index database"""
+        self._db.close()
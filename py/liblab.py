@@ -0,0 +1,194 @@
+"""Python bindings for liblab.so, the numerical core shared with the monitors
+
+liblab.so is built from the C headers used by monitor.bin and reproc.bin
+(make liblab.so), so analysis done here uses the same code as the live
+measurements.  Each function passes whole numpy arrays to a batch entry
+point in the library, so the cost of a call does not grow with the number
+of Python objects.
+
+::Use::
+>>> import liblab
+>>> T = liblab.k_t([0.004, 0.0041], Tcj_C=24.5)    # type K, volts to C
+>>> p = liblab.psat(373.15)                         # MPa
+>>> flow = liblab.gas_scfh(volts, 'o2')             # U12 calibration
+>>> V = liblab.blocks(data, 128)                    # robust block means
+
+    The library is found through the LIBLAB environment variable, then next
+to this package (the repository root), then on the system library path.
+
+::Provides methods::
+    psat, latent, k_mv, k_t, gas_scfh, gas_gps, coolant, plate, blocks
+
+::Provides objects::
+    lib, the ctypes library; the lgas.h calibration globals may be read or
+    changed with, e.g., ctypes.c_double.in_dll(liblab.lib, 'LGAS_O2_MW')
+"""
+import os
+import ctypes
+import numpy as np
+
+__version__ = '1.0'
+
+_here = os.path.dirname(os.path.abspath(__file__))
+_candidates = [os.environ.get('LIBLAB', ''),
+               os.path.join(_here, '..', 'liblab.so'),
+               os.path.join(_here, 'liblab.so'),
+               'liblab.so']
+lib = None
+for _path in _candidates:
+    if not _path:
+        continue
+    try:
+        lib = ctypes.CDLL(_path)
+        break
+    except OSError:
+        pass
+if lib is None:
+    raise ImportError('liblab.so was not found; run "make liblab.so" or set LIBLAB')
+
+_dp = np.ctypeslib.ndpointer(dtype=np.float64, flags='C_CONTIGUOUS')
+_uint = ctypes.c_uint
+_double = ctypes.c_double
+
+for _name in ['llab_psat', 'llab_latent', 'llab_k_mv']:
+    getattr(lib, _name).argtypes = [_dp, _dp, _uint]
+    getattr(lib, _name).restype = None
+lib.llab_k_t.argtypes = [_dp, _dp, _uint, _dp, _uint]
+lib.llab_k_t.restype = None
+lib.llab_gas_scfh.argtypes = [_dp, _dp, _uint, _double, _double]
+lib.llab_gas_scfh.restype = None
+lib.llab_gas_gps.argtypes = [_dp, _dp, _uint, _double]
+lib.llab_gas_gps.restype = None
+lib.llab_coolant.argtypes = [_dp, _dp, _dp, _dp, _dp, _uint]
+lib.llab_coolant.restype = _uint
+lib.llab_plate.argtypes = [_dp, _dp, _dp, _dp, _dp, _dp, _uint]
+lib.llab_plate.restype = None
+lib.llab_blocks.argtypes = [_dp, _uint, _uint, _uint, ctypes.c_char_p,
+                            _double, _double, _dp,
+                            ctypes.POINTER(ctypes.c_ulong)]
+lib.llab_blocks.restype = ctypes.c_int
+
+
+def _arrays(*args):
+    """Broadcast the arguments together and return contiguous float64
+copies along with the common shape"""
+    args = np.broadcast_arrays(*[np.asarray(a, dtype=np.float64) for a in args])
+    shape = args[0].shape
+    return [np.ascontiguousarray(a).reshape(-1) for a in args], shape
+
+
+def _unary(fn, x):
+    (x,), shape = _arrays(x)
+    y = np.empty_like(x)
+    fn(x, y, x.size)
+    return y.reshape(shape)
+
+
+def psat(T_K):
+    """Saturation pressure of water in MPa (IF-97); see psat.h
+    p = psat(T_K)
+"""
+    return _unary(lib.llab_psat, T_K)
+
+
+def latent(T_K):
+    """Latent heat of vaporization of water; see psat.h
+    hfg = latent(T_K)
+"""
+    return _unary(lib.llab_latent, T_K)
+
+
+def k_mv(T_C):
+    """Type K thermocouple voltage in mV referenced to 0 C
+    mV = k_mv(T_C)
+"""
+    return _unary(lib.llab_k_mv, T_C)
+
+
+def k_t(volts, Tcj_C=0.):
+    """Type K junction temperature in C; NaN where out of range
+    T_C = k_t(volts, Tcj_C=0.)
+
+Note that volts are in V (as measured), not mV as in tc.K.T().
+"""
+    (volts, Tcj), shape = _arrays(volts, Tcj_C)
+    T = np.empty_like(volts)
+    lib.llab_k_t(volts, Tcj, Tcj.size, T, volts.size)
+    return T.reshape(shape)
+
+
+def gas_scfh(volts, gas='o2', slope=None, offset=None):
+    """Flow meter calibration from volts to scfh
+    scfh = gas_scfh(volts, gas='o2', slope=None, offset=None)
+
+gas is 'o2' or 'fg' and selects the default slope and offset from the
+library's LGAS_ globals.
+"""
+    prefix = {'o2':'LGAS_O2_', 'fg':'LGAS_FG_'}[gas]
+    if slope is None:
+        slope = _double.in_dll(lib, prefix + 'SLOPE_SCFH').value
+    if offset is None:
+        offset = _double.in_dll(lib, prefix + 'OFFSET_SCFH').value
+    (volts,), shape = _arrays(volts)
+    scfh = np.empty_like(volts)
+    lib.llab_gas_scfh(volts, scfh, volts.size, slope, offset)
+    return scfh.reshape(shape)
+
+
+def gas_gps(scfh, gas='o2', mw=None):
+    """Mass flow in g/s from a volume flow in scfh
+    gps = gas_gps(scfh, gas='o2', mw=None)
+
+gas is 'o2' or 'fg' and selects the default molecular weight.
+"""
+    if mw is None:
+        mw = _double.in_dll(lib, {'o2':'LGAS_O2_MW', 'fg':'LGAS_FG_MW'}[gas]).value
+    (scfh,), shape = _arrays(scfh)
+    gps = np.empty_like(scfh)
+    lib.llab_gas_gps(scfh, gps, scfh.size, mw)
+    return gps.reshape(shape)
+
+
+def coolant(air_gps, water_gps, Tlow_C, Thigh_C):
+    """Coolant heat in kW; NaN where a temperature is out of range
+    Q_kW = coolant(air_gps, water_gps, Tlow_C, Thigh_C)
+"""
+    (air, water, Tlow, Thigh), shape = _arrays(air_gps, water_gps, Tlow_C, Thigh_C)
+    Q = np.empty_like(air)
+    lib.llab_coolant(air, water, Tlow, Thigh, Q, air.size)
+    return Q.reshape(shape)
+
+
+def plate(Thigh_C, Tlow_C, coolTlow_C, coolThigh_C):
+    """Plate heat in kW and peak plate temperature in C
+    Q_kW, Tpeak_C = plate(Thigh_C, Tlow_C, coolTlow_C, coolThigh_C)
+"""
+    (Thigh, Tlow, cTlow, cThigh), shape = _arrays(Thigh_C, Tlow_C,
+                                                  coolTlow_C, coolThigh_C)
+    Q = np.empty_like(Thigh)
+    Tpeak = np.empty_like(Thigh)
+    lib.llab_plate(Thigh, Tlow, cTlow, cThigh, Q, Tpeak, Thigh.size)
+    return Q.reshape(shape), Tpeak.reshape(shape)
+
+
+def blocks(data, navg, mode='mad', k=0., trim=0.):
+    """Reduce each channel to one robust estimate per block of navg samples
+    out, rejected = blocks(data, navg, mode='mad', k=0., trim=0.)
+
+data is a (samples x channels) array, as in lconfig data files.  mode is
+'mean', 'median', 'trim', or 'mad'; see lrobust.h.  out is a
+(samples//navg x channels) array and rejected counts the spikes removed.
+"""
+    data = np.ascontiguousarray(data, dtype=np.float64)
+    if data.ndim == 1:
+        data = data.reshape((-1, 1))
+    samples, channels = data.shape
+    if navg < 1:
+        raise ValueError('blocks: invalid mode %r or navg %r' % (mode, navg))
+    out = np.empty((samples // navg, channels))
+    rejected = ctypes.c_ulong(0)
+    if lib.llab_blocks(data.reshape(-1), channels, samples, navg,
+                       mode.encode(), k, trim, out.reshape(-1),
+                       ctypes.byref(rejected)):
+        raise ValueError('blocks: invalid mode %r or navg %r' % (mode, navg))
+    return out, rejected.value
@@ -1,5 +1,6 @@
 import matplotlib.pyplot as plt
 import matplotlib as mpl
+import numpy as np
 
 
 AX1_LABEL = 'LPLOT_AX1'
@@ -320,4 +321,125 @@ def floating_legend(fig, loc, fmt, loc_edge='lt', vpadding_inches=.05, hpadding_
         ax.text(x,y,row[-1],verticalalignment='center')
         y -= vpadding + char_height
         
-    fig.canvas.draw()
\ No newline at end of file
+    fig.canvas.draw()
+
+
+
+class Envelope:
+    """Multi-resolution min/max envelope for plotting very long signals
+    E = Envelope(t, y)
+    
+T and Y are 1D arrays of equal length; T must be increasing.  On 
+creation, a pyramid of min/max summaries is built in a few vectorized 
+passes.  Level k summarizes bins of 2**k samples by the indices of their 
+minimum and maximum, so the pyramid costs about two indices per sample.
+
+    tt, yy = E.get(t0=None, t1=None, npix=1000)
+
+returns at most 2*npix points that span t0 to t1.  Each pixel column is 
+represented by its true minimum and maximum samples, in time order, so 
+spikes are never lost the way they are by stride decimation.  Because 
+the returned points are real samples, every peak is kept exactly.  
+Windows with fewer than 2*npix samples are returned undecimated.
+"""
+    def __init__(self, t, y):
+        self.t = np.asarray(t)
+        self.y = np.asarray(y)
+        if self.t.shape != self.y.shape or self.y.ndim != 1:
+            raise Exception('ENVELOPE: t and y must be 1D arrays of equal length')
+        
+        dtype = np.int32 if self.y.size < 2**31 else np.int64
+        # Level 0 is the raw data
+        # The odd sample at the end of each level is carried up on its own
+        self._levels = [None]
+        imin = imax = np.arange(self.y.size, dtype=dtype)
+        while imin.size > 1:
+            imin = self._reduce(imin, np.argmin)
+            imax = self._reduce(imax, np.argmax)
+            self._levels.append((imin, imax))
+            
+    def _reduce(self, index, fun):
+        """Combine neighboring pairs of indices using argmin or argmax"""
+        n2 = index.size - index.size%2
+        pairs = index[:n2].reshape((-1,2))
+        out = pairs[np.arange(pairs.shape[0]), fun(self.y[pairs], axis=1)]
+        if n2 < index.size:
+            out = np.append(out, index[-1])
+        return out
+        
+    def get(self, t0=None, t1=None, npix=1000):
+        """Return the envelope between t0 and t1 with npix pixel columns
+    tt, yy = get(t0=None, t1=None, npix=1000)
+"""
+        npix = max(int(npix), 1)
+        i0 = 0 if t0 is None else max(np.searchsorted(self.t, t0)-1, 0)
+        i1 = self.y.size if t1 is None else \
+                min(np.searchsorted(self.t, t1)+1, self.y.size)
+        n = i1 - i0
+        if n <= 2*npix:
+            return self.t[i0:i1], self.y[i0:i1]
+        
+        # Pick the coarsest level with at least npix bins in the window
+        level = min(int(np.log2(float(n)/npix)), len(self._levels)-1)
+        b0 = i0 >> level
+        b1 = ((i1-1) >> level) + 1
+        if level:
+            imin, imax = self._levels[level]
+            imin = imin[b0:b1]
+            imax = imax[b0:b1]
+        else:
+            imin = imax = np.arange(b0, b1)
+        
+        # Group the bins into pixel columns and reduce each column
+        group = -(-imin.size // npix)
+        pad = (-imin.size) % group
+        if pad:
+            imin = np.append(imin, np.repeat(imin[-1], pad))
+            imax = np.append(imax, np.repeat(imax[-1], pad))
+        imin = imin.reshape((-1,group))
+        imax = imax.reshape((-1,group))
+        rows = np.arange(imin.shape[0])
+        imin = imin[rows, np.argmin(self.y[imin], axis=1)]
+        imax = imax[rows, np.argmax(self.y[imax], axis=1)]
+        
+        # Emit each column's extrema in time order
+        index = np.empty(2*imin.size, dtype=imin.dtype)
+        index[0::2] = np.minimum(imin, imax)
+        index[1::2] = np.maximum(imin, imax)
+        return self.t[index], self.y[index]
+
+
+def plot_envelope(ax, t, y, envelope=None, npix=None, **kwarg):
+    """Plot a long signal as a min/max envelope that follows zoom and pan
+    ll = plot_envelope(ax, t, y, envelope=None, npix=None, **kwarg)
+    
+AX is the axes on which to plot, and T and Y are the data.  Additional
+keyword arguments are passed to ax.plot().  Returns the line object.
+
+An Envelope built from T and Y may be passed with the ENVELOPE keyword 
+to avoid rebuilding it; in that case, T and Y are ignored.  NPIX is the
+number of pixel columns; by default the axes width in pixels is used.
+
+Whenever the x-limits of the axes change, the line is recomputed from 
+the envelope pyramid, so zooming in reveals full detail and zooming out
+never hands matplotlib more than 2*npix points.
+"""
+    if envelope is None:
+        envelope = Envelope(t, y)
+    
+    def _npix():
+        if npix:
+            return npix
+        return max(int(ax.get_window_extent().width), 100)
+    
+    tt, yy = envelope.get(npix=_npix())
+    ll, = ax.plot(tt, yy, **kwarg)
+    
+    def _update(this_ax):
+        t0, t1 = this_ax.get_xlim()
+        tt, yy = envelope.get(t0, t1, npix=_npix())
+        ll.set_data(tt, yy)
+        this_ax.figure.canvas.draw_idle()
+    
+    ax.callbacks.connect('xlim_changed', _update)
+    return ll
@@ -0,0 +1,196 @@
+"""Live access to the shared memory sample ring published by lshm.h
+
+The monitor (started with -m name) publishes its sample stream to the
+POSIX shared memory segment /dev/shm/name.  This module maps that segment
+and exposes its contents as numpy arrays that point directly into shared
+memory, so reading the latest samples costs no copies, no sockets and no
+load on the acquisition.
+
+::Use::
+>>> import lshm
+>>> R = lshm.LShm('monitor')
+>>> t, raw, cal = R.latest(1000)    # Views of the most recent 1000 samples
+>>> plt.plot(t, cal[:,0])
+
+    For online analysis, poll for new samples by stream index
+>>> index = R.index()
+>>> ... later ...
+>>> t, raw, cal, index = R.since(index)
+
+    Views reference live memory.  The producer will eventually overwrite
+    them, so call R.valid(start) after using them, or copy them first.
+
+    When the monitor stores raw ADC counts (int:rawbits in its
+    configuration), the raw views hold integer counts and there is no
+    calibrated ring.  The cal arrays returned by latest() and since() are
+    then computed from the counts in the requested window only.
+"""
+import os
+import mmap
+import numpy as np
+
+__version__ = '1.1'
+
+MAGIC = b'LSHMRING'
+LAYOUT = 2
+SHM_DIR = '/dev/shm'
+
+# This mirrors the LSHM_HEADER struct in lshm.h
+HEADER = np.dtype([
+    ('magic', 'S8'),
+    ('layout', '<u4'),
+    ('header_size', '<u4'),
+    ('channels', '<u4'),
+    ('dtype', '<u4'),
+    ('capacity', '<u8'),
+    ('write_index', '<u8'),
+    ('samplehz', '<f8'),
+    ('raw_offset', '<u8'),
+    ('cal_offset', '<u8'),
+    ('time_offset', '<u8'),
+    ('slope', '<f8', (16,)),
+    ('zero', '<f8', (16,)),
+    ('rawbits', '<u4'),
+    ('rawsize', '<u4'),
+    ('rawscale', '<f8', (16,)),
+    ('rawoffset', '<f8', (16,)),
+    ('write_pending', '<u8')])
+
+DTYPES = {0:np.float64, 1:np.int16, 2:np.int32}
+
+
+class LShm:
+    """Shared memory sample ring reader
+    R = LShm(name)
+
+NAME is the segment name given to the monitor (without /dev/shm).  The
+header is verified on open.  These members are available:
+    R.channels  Number of channels per sample
+    R.capacity  Number of samples retained by the ring
+    R.samplehz  Nominal sample rate, read from the header on each access
+    R.slope     Per-channel calibration slopes
+    R.zero      Per-channel calibration zeros
+    R.rawbits   Converter resolution of raw counts, or 0 for voltages
+    R.raw       (2*capacity, channels) view of the raw voltage or count ring
+    R.cal       (2*capacity, channels) view of the calibrated ring or None
+    R.time      (2*capacity,) view of the sample timestamps
+
+The rings are mirrored; see lshm.h.  Use latest() and since() rather
+than indexing them directly.
+"""
+    def __init__(self, name):
+        self.filename = os.path.join(SHM_DIR, name)
+        with open(self.filename, 'rb') as ff:
+            self._map = mmap.mmap(ff.fileno(), 0, access=mmap.ACCESS_READ)
+        self._header = np.frombuffer(self._map, dtype=HEADER, count=1)[0]
+
+        if self._header['magic'] != MAGIC:
+            raise Exception('LSHM: %s is not a sample ring'%self.filename)
+        if self._header['layout'] != LAYOUT:
+            raise Exception('LSHM: Unsupported layout %d'%self._header['layout'])
+
+        self.channels = int(self._header['channels'])
+        self.capacity = int(self._header['capacity'])
+        self.slope = self._header['slope'][:self.channels]
+        self.zero = self._header['zero'][:self.channels]
+        self.rawbits = int(self._header['rawbits'])
+        self.rawscale = self._header['rawscale'][:self.channels]
+        self.rawoffset = self._header['rawoffset'][:self.channels]
+
+        dtype = DTYPES[int(self._header['dtype'])]
+        rows = 2*self.capacity
+        self.raw = np.frombuffer(self._map, dtype=dtype,
+                count=rows*self.channels,
+                offset=int(self._header['raw_offset'])).reshape((rows, self.channels))
+        self.cal = None
+        if self._header['cal_offset']:
+            self.cal = np.frombuffer(self._map, dtype=np.float64,
+                    count=rows*self.channels,
+                    offset=int(self._header['cal_offset'])).reshape((rows, self.channels))
+        self.time = np.frombuffer(self._map, dtype=np.float64,
+                count=rows, offset=int(self._header['time_offset']))
+
+    @property
+    def samplehz(self):
+        """The nominal sample rate; the monitor updates it on a reload"""
+        return float(self._header['samplehz'])
+
+    def index(self):
+        """Return the total number of samples written so far"""
+        return int(self._header['write_index'])
+
+    def pending(self):
+        """Return the index the block being written will bring the ring to
+    pending()
+
+This equals index() when no write is in progress.  Rows from
+pending() - capacity on are safe from the write in progress.
+"""
+        return max(int(self._header['write_pending']), self.index())
+
+    def valid(self, start):
+        """Test whether samples from stream index START on are still intact
+    valid(start)
+
+Returns True if the producer has not overwritten (and is not now
+overwriting) sample START.  Call this after using a view to confirm
+that it was not overwritten while it was in use.
+"""
+        return self.pending() - start <= self.capacity
+
+    def calibrate(self, raw):
+        """Convert raw values from the ring to calibrated values
+    cal = calibrate(raw)
+    
+Raw counts are first converted to volts with the per-channel rawscale
+and rawoffset, then slope * (volts - zero) is applied.  This always
+returns a new array.
+"""
+        if self.rawbits:
+            volts = raw * self.rawscale + self.rawoffset
+        else:
+            volts = raw
+        return self.slope * (volts - self.zero)
+
+    def _window(self, start, stop):
+        """Return views of the samples from stream index start to stop"""
+        I0 = start % self.capacity
+        I1 = I0 + (stop - start)
+        if self.cal is None:
+            return self.time[I0:I1], self.raw[I0:I1], \
+                    self.calibrate(self.raw[I0:I1])
+        return self.time[I0:I1], self.raw[I0:I1], self.cal[I0:I1]
+
+    def latest(self, count=None):
+        """Return views of the most recent samples
+    t, raw, cal = latest(count=None)
+
+COUNT is the number of samples requested.  It is clamped to the number
+of samples available and the ring capacity, less any rows claimed by a
+write in progress.  If it is omitted, the
+entire ring is returned.
+"""
+        stop = self.index()
+        if count is None or count > self.capacity:
+            count = self.capacity
+        # Leave out rows claimed by a write in progress
+        count = max(0, min(count, stop, self.capacity - (self.pending() - stop)))
+        return self._window(stop-count, stop)
+
+    def since(self, start):
+        """Return views of all samples written since stream index START
+    t, raw, cal, stop = since(start)
+
+STOP is the stream index to pass to the next call.  If the producer has
+lapped the reader, the oldest samples are lost and the returned block
+begins with the oldest sample still available.
+"""
+        stop = self.index()
+        start = min(max(start, self.pending() - self.capacity), stop)
+        t, raw, cal = self._window(start, stop)
+        return t, raw, cal, stop
+
+    def close(self):
+        """Release the mapping"""
+        self.raw = self.cal = self.time = self._header = None
+        self._map.close()
@@ -21,6 +21,9 @@ https://srdata.nist.gov/its90/main/its90_main_page.html
     thermocouples of the same names.
 
     'provides' is a list containing these _tc objects.
+
+    K uses liblab.so (see liblab.py) when it can be loaded, so that it gives
+    the same values as monitor.bin and reproc.bin.
     
 ::Provides methods::
     test() plots the characteristics of each TC and estimates temperature error
@@ -442,5 +445,50 @@ K.mV = type(K.mV)(KmV, K, _tc)
 del KmV
 
 
+# When liblab.so can be loaded, type K is evaluated by the same compiled
+# code as monitor.bin and reproc.bin (see ltc.h).  The polynomials are the
+# same, but values out of range are NaN instead of an exception.
+try:
+    import liblab as _liblab
+except ImportError:
+    _liblab = None
+
+def _to_C(T, units):
+    T = np.asarray(T, dtype=float)
+    if units=='K':
+        return T - 273.15
+    elif units=='R':
+        return T/1.8 - 273.15
+    elif units=='F':
+        return (T-32.)/1.8
+    elif units=='C':
+        return T
+    raise Exception('Unrecognized temperature units')
+
+def _from_C(T, units):
+    if units=='K':
+        return T + 273.15
+    elif units=='R':
+        return (T+273.15)*1.8
+    elif units=='F':
+        return T*1.8 + 32.
+    elif units=='C':
+        return T
+    raise Exception('Unrecognized temperature units')
+
+if _liblab is not None:
+    def KmV(self, T, units='C'):
+        return np.atleast_1d(_liblab.k_mv(_to_C(T, units)))
+
+    def KT(self, mV, units='C', Tcj=None):
+        Tcj_C = 0. if Tcj is None else _to_C(Tcj, units)
+        volts = np.asarray(mV, dtype=float) / 1000.
+        return _from_C(np.atleast_1d(_liblab.k_t(volts, Tcj_C)), units)
+
+    K.mV = type(K.mV)(KmV, K, _tc)
+    K.T = type(K.T)(KT, K, _tc)
+    del KmV, KT
+
+
 # Build the list of available thermocouples
 provides = [B, E, J, K, N, R, S, T]
\ No newline at end of file
@@ -0,0 +1,836 @@
+/*
+.
+.   Batch reprocessing of LCONFIG data files
+.
+.   (c) 2016
+.   Released under GPLv3.0
+.   Chris Martin
+.   Assistant Professor of Mechanical Engineering
+.   Penn State University, Altoona College
+.
+.   REPROC reads a list of data files (or every .dat file in a directory),
+.   calibrates the analog inputs, converts the thermocouple voltages,
+.   converts the flow meter voltages to mass flows, and evaluates the
+.   coolant and plate heat balances.  For each input file, the derived
+.   channels are written to a .proc file, and the summary statistics of
+.   every channel are written to a single summary table.
+.
+.   The statistics include percentiles from quantile sketches (see
+.   lstat.h).  Each file's sketches are saved in a .stat file next to its
+.   .proc file, and the sketches of every file are merged by column name
+.   into campaign rows (file ALL) at the end of the table.  Saved .stat
+.   files (from reproc.bin or monitor.bin) can be merged later with -m
+.   without reading the data again.
+.
+.   Files are processed in parallel by a pool of worker threads.  The files
+.   are dealt to per-thread queues largest last; each thread works through
+.   its own queue from the largest file down and steals the smallest
+.   remaining file from another queue when its own runs dry.
+.
+*/
+
+#include "lconfig.h"
+#include "lgas.h"           // For the flow meter calibrations
+#include "ltc.h"            // For the type K conversion
+#include "lheat.h"          // For the coolant and plate heat balances
+#include "lstat.h"          // For percentiles and mergeable sketches
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+
+#define REPROC_MAX_PATH     512
+#define REPROC_MAX_MSG      128
+#define REPROC_MAX_THREAD   64
+#define REPROC_LINE         4096
+#define REPROC_DEF_TCJ_C    25.
+#define PROC_EXT            ".proc"
+#define STAT_EXT            ".stat"
+
+// Indices of the derived channels
+// These must be in the same order as derived_names[]
+#define D_TIME          0
+#define D_PLATE_THIGH   1
+#define D_PLATE_TLOW    2
+#define D_COOL_THIGH    3
+#define D_COOL_TLOW     4
+#define D_O2_SCFH       5
+#define D_FG_SCFH       6
+#define D_O2_GPS        7
+#define D_FG_GPS        8
+#define D_PLATE_Q       9
+#define D_PLATE_TPEAK   10
+#define D_COOL_Q        11
+#define NDERIVED        12
+
+#define NCOL_MAX    (LCONF_MAX_NAICH + NDERIVED)
+#define NTOTAL_MAX  (4 * NCOL_MAX)      // Distinct column names in a campaign
+#define NQ          3                   // Percentiles in stat_q[]
+
+/********************************
+ *                              *
+ *      Global Variables        *
+ *                              *
+ ********************************/
+
+const char* derived_names[NDERIVED] = {
+    "time_s", "plate_Thigh_C", "plate_Tlow_C", "cool_Thigh_C",
+    "cool_Tlow_C", "oxygen_scfh", "fuel_scfh", "oxygen_gps", "fuel_gps",
+    "plate_Q_kW", "plate_Tpeak_C", "cool_Q_kW"};
+
+// Summary statistics of one column
+// The sketches are too large to keep for every file, so only the results
+// are kept.
+typedef struct {
+    char name[LCONF_MAX_STR];
+    unsigned long long n;   // Number of finite values
+    double mean, std, min, max;
+    double p[NQ];           // Percentiles at stat_q[]
+} STAT;
+
+// One data file and its results
+typedef struct {
+    char path[REPROC_MAX_PATH];
+    off_t size;
+    int err;
+    char message[REPROC_MAX_MSG];
+    unsigned long samples;
+    unsigned int ncol;
+    STAT stat[NCOL_MAX];
+} JOB;
+
+// Per-thread work queue
+// The owner takes from the tail; thieves take from the head.
+typedef struct {
+    pthread_mutex_t lock;
+    unsigned int *job;
+    unsigned int head, tail;
+} QUEUE;
+
+// Options shared by every worker; these are not changed once the pool
+// has started.
+struct {
+    char outdir[REPROC_MAX_PATH];
+    unsigned int navg;      // Samples averaged per row; 0 uses nsample
+    int tc[4];              // Plate high, plate low, coolant high, low
+    int o2, fg;             // Flow meter channels; -1 if absent
+    double water_gph, air_psig, tcj_C;  // NAN unless set on command line
+} opt;
+
+JOB *jobs = NULL;
+unsigned int njobs = 0, ndone = 0;
+QUEUE queue[REPROC_MAX_THREAD];
+unsigned int nthreads;
+pthread_mutex_t progress_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const double stat_q[NQ] = {0.01, 0.5, 0.99};
+
+// Campaign statistics merged from every file by column name
+struct {
+    pthread_mutex_t lock;
+    unsigned long samples;
+    unsigned int n;
+    char name[NTOTAL_MAX][LSTAT_MAX_STR];
+    LSTAT* stat;            // NTOTAL_MAX sketches
+} total = {PTHREAD_MUTEX_INITIALIZER};
+
+const char help[] = "reproc.bin [options] file_or_dir ...\n"\
+"  -j N       Use N worker threads (default: all cores)\n"\
+"  -d dir     Write the .proc files to this directory\n"\
+"  -s file    Write the summary table to this file (default: stdout)\n"\
+"  -S file    Also write the merged campaign sketches to this file\n"\
+"  -m         Merge the .stat files given instead of reading data files\n"\
+"  -n N       Average N samples per derived row (default: nsample); a\n"\
+"             shorter last block is averaged over the samples it has\n"\
+"  -T a,b,c,d Thermocouple channels; plate high, plate low, coolant high,\n"\
+"             coolant low (default: 0,1,2,3)\n"\
+"  -o ch      Oxygen flow meter channel\n"\
+"  -f ch      Fuel gas flow meter channel\n"\
+"  -w gph     Coolant water flow (default: flt:water_gph or 0)\n"\
+"  -a psig    Coolant air pressure (default: flt:air_psig or 0)\n"\
+"  -c C       Cold junction temperature (default: flt:tcj_C or 25)\n";
+
+/********************************
+ *                              *
+ *          Prototypes          *
+ *                              *
+ ********************************/
+
+/* ADD_PATH
+.   Add a data file to the job list, or every .dat file in a directory.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int add_path(const char* path);
+
+
+/* PROCESS_FILE
+.   Load the configuration header of a data file, stream its samples, and
+.   write the derived channels and their sketches.  sketch is room for
+.   NCOL_MAX sketches.  Errors are recorded in job->err and job->message.
+*/
+void process_file(JOB* job, DEVCONF* dconf, LSTAT* sketch);
+
+
+/* TAKE_JOB
+.   Take the next job for worker number self, stealing from the other
+.   queues if its own is empty.
+.
+.   Returns 0 and writes the job index on success, or 1 if no work remains.
+*/
+int take_job(const unsigned int self, unsigned int* index);
+
+
+/* WORKER
+.   Thread entry point.  arg points to the worker number.
+*/
+void* worker(void* arg);
+
+
+/* MERGE_TOTAL
+.   Merge a column's sketch into the campaign statistics of that name.
+.
+.   Returns 0 on success and 1 if there are too many names.
+*/
+int merge_total(const char* name, const LSTAT* sketch);
+
+
+/* WRITE_STAT_FILE
+.   Write sketches with lstat_write(), one per line, after a comment with
+.   the sample count.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int write_stat_file(const char* path, const unsigned long samples,
+                const char names[][LSTAT_MAX_STR], const LSTAT* sketch,
+                const unsigned int n);
+
+
+/* READ_STAT_FILE
+.   Merge every sketch in a .stat file into the campaign statistics.  Lines
+.   that are not sketches (like monitor.bin's summary table) are skipped.
+.
+.   Returns 0 on success and 1 on an error.
+*/
+int read_stat_file(const char* path);
+
+
+/* WRITE_SUMMARY
+.   Write one row per file and column with the sample count, mean, standard
+.   deviation, minimum, maximum, and 1st, 50th, and 99th percentiles,
+.   followed by the campaign rows.
+*/
+void write_summary(FILE* ff);
+
+
+
+/********************************
+ *                              *
+ *          Algorithm           *
+ *                              *
+ ********************************/
+
+int main(int argc, char* argv[]){
+    int ii, c, err = 0;
+    unsigned int jj, kk, *order, id[REPROC_MAX_THREAD];
+    pthread_t thread[REPROC_MAX_THREAD];
+    char summary[REPROC_MAX_PATH] = "", sketches[REPROC_MAX_PATH] = "";
+    int merge = 0;
+    FILE* ff;
+
+    // Defaults
+    memset(&opt, 0, sizeof(opt));
+    opt.tc[0] = 0; opt.tc[1] = 1; opt.tc[2] = 2; opt.tc[3] = 3;
+    opt.o2 = opt.fg = -1;
+    opt.water_gph = opt.air_psig = opt.tcj_C = NAN;
+    ii = sysconf(_SC_NPROCESSORS_ONLN);
+    nthreads = ii > 0 ? ii : 1;
+
+    while((c = getopt(argc, argv, "j:d:s:S:mn:T:o:f:w:a:c:h")) != -1){
+        switch(c){
+            case 'j':
+                nthreads = atoi(optarg);
+            break;
+            case 'd':
+                strncpy(opt.outdir, optarg, REPROC_MAX_PATH-1);
+            break;
+            case 's':
+                strncpy(summary, optarg, REPROC_MAX_PATH-1);
+            break;
+            case 'S':
+                strncpy(sketches, optarg, REPROC_MAX_PATH-1);
+            break;
+            case 'm':
+                merge = 1;
+            break;
+            case 'n':
+                opt.navg = atoi(optarg);
+            break;
+            case 'T':
+                if(sscanf(optarg, "%d,%d,%d,%d",
+                        &opt.tc[0], &opt.tc[1], &opt.tc[2], &opt.tc[3]) != 4){
+                    fputs("REPROC: -T requires four channels\n", stderr);
+                    return -1;
+                }
+            break;
+            case 'o':
+                opt.o2 = atoi(optarg);
+            break;
+            case 'f':
+                opt.fg = atoi(optarg);
+            break;
+            case 'w':
+                opt.water_gph = atof(optarg);
+            break;
+            case 'a':
+                opt.air_psig = atof(optarg);
+            break;
+            case 'c':
+                opt.tcj_C = atof(optarg);
+            break;
+            default:
+                fputs(help, stderr);
+                return -1;
+        }
+    }
+    if(optind >= argc){
+        fputs(help, stderr);
+        return -1;
+    }
+    if(nthreads < 1)
+        nthreads = 1;
+    else if(nthreads > REPROC_MAX_THREAD)
+        nthreads = REPROC_MAX_THREAD;
+
+    total.stat = malloc(NTOTAL_MAX * sizeof(LSTAT));
+    if(total.stat == NULL){
+        fputs("REPROC: Out of memory\n", stderr);
+        return -1;
+    }
+
+    // Saved sketches are merged directly; there are no jobs
+    if(merge){
+        for(ii=optind; ii<argc; ii++)
+            if(read_stat_file(argv[ii]))
+                return -1;
+        goto report;
+    }
+
+    for(ii=optind; ii<argc; ii++)
+        if(add_path(argv[ii]))
+            return -1;
+    if(njobs == 0){
+        fputs("REPROC: No data files found\n", stderr);
+        return -1;
+    }
+    if(nthreads > njobs)
+        nthreads = njobs;
+
+    // Deal the files to the queues in order of increasing size so that
+    // each owner starts with its largest file
+    order = malloc(njobs * sizeof(unsigned int));
+    for(jj=0; jj<njobs; jj++)
+        order[jj] = jj;
+    for(jj=1; jj<njobs; jj++)
+        for(kk=jj; kk>0 && jobs[order[kk-1]].size > jobs[order[kk]].size; kk--){
+            c = order[kk]; order[kk] = order[kk-1]; order[kk-1] = c;
+        }
+    for(jj=0; jj<nthreads; jj++){
+        pthread_mutex_init(&queue[jj].lock, NULL);
+        queue[jj].job = malloc((njobs/nthreads + 1) * sizeof(unsigned int));
+        queue[jj].head = queue[jj].tail = 0;
+    }
+    for(jj=0; jj<njobs; jj++){
+        kk = jj % nthreads;
+        queue[kk].job[queue[kk].tail++] = order[jj];
+    }
+    free(order);
+
+    // Run the pool
+    for(jj=0; jj<nthreads; jj++){
+        id[jj] = jj;
+        if(pthread_create(&thread[jj], NULL, worker, &id[jj])){
+            fprintf(stderr, "REPROC: Failed to start worker %u\n", jj);
+            return -1;
+        }
+    }
+    for(jj=0; jj<nthreads; jj++){
+        pthread_join(thread[jj], NULL);
+        pthread_mutex_destroy(&queue[jj].lock);
+        free(queue[jj].job);
+    }
+
+    // Report
+report:
+    ff = summary[0] ? fopen(summary, "w") : stdout;
+    if(ff == NULL){
+        fprintf(stderr, "REPROC: Failed to open summary file %s\n", summary);
+        return -1;
+    }
+    write_summary(ff);
+    if(ff != stdout)
+        fclose(ff);
+    if(sketches[0] && write_stat_file(sketches, total.samples,
+            (const char (*)[LSTAT_MAX_STR])total.name, total.stat, total.n)){
+        fprintf(stderr, "REPROC: Failed to write %s\n", sketches);
+        err = 1;
+    }
+    for(jj=0; jj<njobs; jj++)
+        if(jobs[jj].err){
+            fprintf(stderr, "REPROC: %s: %s\n", jobs[jj].path, jobs[jj].message);
+            err = 1;
+        }
+    free(jobs);
+    free(total.stat);
+    return err;
+}
+
+
+//******************************************************************************
+static int add_file(const char* path){
+    struct stat st;
+    JOB* temp;
+
+    if(strlen(path) >= REPROC_MAX_PATH - sizeof(PROC_EXT)){
+        fprintf(stderr, "REPROC: Path is too long: %s\n", path);
+        return 1;
+    }
+    temp = realloc(jobs, (njobs+1) * sizeof(JOB));
+    if(temp == NULL){
+        fputs("REPROC: Out of memory\n", stderr);
+        return 1;
+    }
+    jobs = temp;
+    memset(&jobs[njobs], 0, sizeof(JOB));
+    strcpy(jobs[njobs].path, path);
+    jobs[njobs].size = stat(path, &st) ? 0 : st.st_size;
+    njobs++;
+    return 0;
+}
+
+static int compare_names(const void* a, const void* b){
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+//******************************************************************************
+int add_path(const char* path){
+    struct stat st;
+    struct dirent* entry;
+    DIR* dd;
+    char **names = NULL, **temp, file[REPROC_MAX_PATH];
+    unsigned int ii, count = 0;
+    size_t length;
+    int err = 0;
+
+    if(stat(path, &st)){
+        fprintf(stderr, "REPROC: Cannot find %s\n", path);
+        return 1;
+    }else if(!S_ISDIR(st.st_mode))
+        return add_file(path);
+
+    // Collect the .dat files in the directory and add them in name order
+    dd = opendir(path);
+    if(dd == NULL){
+        fprintf(stderr, "REPROC: Cannot read directory %s\n", path);
+        return 1;
+    }
+    while((entry = readdir(dd))){
+        length = strlen(entry->d_name);
+        if(length < 5 || strcmp(&entry->d_name[length-4], ".dat"))
+            continue;
+        temp = realloc(names, (count+1) * sizeof(char*));
+        if(temp == NULL){
+            err = 1;
+            break;
+        }
+        names = temp;
+        names[count++] = strdup(entry->d_name);
+    }
+    closedir(dd);
+    qsort(names, count, sizeof(char*), compare_names);
+    for(ii=0; ii<count; ii++){
+        if(!err){
+            snprintf(file, REPROC_MAX_PATH, "%s/%s", path, names[ii]);
+            err = add_file(file);
+        }
+        free(names[ii]);
+    }
+    free(names);
+    return err;
+}
+
+
+//******************************************************************************
+int take_job(const unsigned int self, unsigned int* index){
+    unsigned int ii;
+    QUEUE* q;
+
+    // Our own queue first, largest file first
+    q = &queue[self];
+    pthread_mutex_lock(&q->lock);
+    if(q->head < q->tail){
+        *index = q->job[--q->tail];
+        pthread_mutex_unlock(&q->lock);
+        return 0;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    // Steal the smallest remaining file from the next non-empty queue
+    for(ii=1; ii<nthreads; ii++){
+        q = &queue[(self + ii) % nthreads];
+        pthread_mutex_lock(&q->lock);
+        if(q->head < q->tail){
+            *index = q->job[q->head++];
+            pthread_mutex_unlock(&q->lock);
+            return 0;
+        }
+        pthread_mutex_unlock(&q->lock);
+    }
+    return 1;
+}
+
+
+//******************************************************************************
+void* worker(void* arg){
+    unsigned int self, index;
+    DEVCONF* dconf;
+    LSTAT* sketch;
+
+    self = *(unsigned int*)arg;
+    // The configuration and sketches are too large for the thread's stack
+    dconf = malloc(sizeof(DEVCONF));
+    sketch = malloc(NCOL_MAX * sizeof(LSTAT));
+    if(dconf == NULL || sketch == NULL){
+        free(dconf);
+        free(sketch);
+        return NULL;
+    }
+
+    while(!take_job(self, &index)){
+        process_file(&jobs[index], dconf, sketch);
+        pthread_mutex_lock(&progress_lock);
+        ndone++;
+        fprintf(stderr, "[%u/%u] %s%s\n", ndone, njobs, jobs[index].path,
+                jobs[index].err ? " (failed)" : "");
+        pthread_mutex_unlock(&progress_lock);
+    }
+    free(dconf);
+    free(sketch);
+    return NULL;
+}
+
+
+//******************************************************************************
+// Reduce a sketch to the numbers kept for the summary
+static void stat_reduce(STAT* s, const LSTAT* sketch){
+    s->n = sketch->n;
+    s->mean = sketch->n ? sketch->mean : NAN;
+    s->std = lstat_std(sketch);
+    s->min = sketch->min;
+    s->max = sketch->max;
+    lstat_quantiles(sketch, stat_q, NQ, s->p);
+}
+
+//******************************************************************************
+void process_file(JOB* job, DEVCONF* dconf, LSTAT* sketch){
+    FILE *ff = NULL, *fo = NULL;
+    char line[REPROC_LINE], outpath[2*REPROC_MAX_PATH], param[32];
+    char names[NCOL_MAX][LSTAT_MAX_STR];
+    char *start, *end, *base;
+    double sum[LCONF_MAX_NAICH], v[LCONF_MAX_NAICH], row[NCOL_MAX];
+    double rawscale[LCONF_MAX_NAICH], rawoffset[LCONF_MAX_NAICH];
+    double water_gph = 0., air_psig = 0., tcj_C = REPROC_DEF_TCJ_C;
+    double o2_offset = LGAS_O2_OFFSET_SCFH, fg_offset = LGAS_FG_OFFSET_SCFH;
+    double water_gps, air_gps, dt;
+    unsigned int ii, jj, naich, navg, count;
+    unsigned long index;
+    int rawbits = 0, newline, last;
+
+#define FAIL(...) do{ job->err = 1; \
+        snprintf(job->message, REPROC_MAX_MSG, __VA_ARGS__); \
+        goto done; }while(0)
+
+    // Load the configuration from the file's header
+    if(load_config(dconf, 1, job->path))
+        FAIL("Failed to load the configuration header");
+    naich = dconf[0].naich;
+    if(naich == 0 || naich > LCONF_MAX_NAICH)
+        FAIL("Unsupported channel count %u", naich);
+    for(ii=0; ii<4; ii++)
+        if(opt.tc[ii] < 0 || opt.tc[ii] >= (int)naich)
+            FAIL("Thermocouple channel %d does not exist", opt.tc[ii]);
+    if(opt.o2 >= (int)naich || opt.fg >= (int)naich)
+        FAIL("Flow meter channel does not exist");
+
+    // Per-file settings come from the meta parameters unless they were
+    // given on the command line
+    get_meta_flt(dconf, 0, "water_gph", &water_gph);
+    get_meta_flt(dconf, 0, "air_psig", &air_psig);
+    get_meta_flt(dconf, 0, "tcj_C", &tcj_C);
+    get_meta_flt(dconf, 0, "o2offset", &o2_offset);
+    get_meta_flt(dconf, 0, "fgoffset", &fg_offset);
+    if(!isnan(opt.water_gph))
+        water_gph = opt.water_gph;
+    if(!isnan(opt.air_psig))
+        air_psig = opt.air_psig;
+    if(!isnan(opt.tcj_C))
+        tcj_C = opt.tcj_C;
+    water_gps = lheat_water_gps(water_gph);
+    air_gps = lheat_air_gps(air_psig);
+
+    // Raw count files (see lraw.h) carry their count format
+    for(ii=0; ii<naich; ii++){
+        rawscale[ii] = 1.;
+        rawoffset[ii] = 0.;
+    }
+    if(!get_meta_int(dconf, 0, "rawbits", &rawbits))
+        for(ii=0; ii<naich; ii++){
+            sprintf(param, "rawscale%u", ii);
+            get_meta_flt(dconf, 0, param, &rawscale[ii]);
+            sprintf(param, "rawoffset%u", ii);
+            get_meta_flt(dconf, 0, param, &rawoffset[ii]);
+        }
+
+    navg = opt.navg ? opt.navg : dconf[0].nsample;
+    if(navg == 0)
+        navg = 1;
+    dt = dconf[0].samplehz > 0. ? 1./dconf[0].samplehz : 0.;
+
+    // Skip past the header to the ## line and the timestamp
+    ff = fopen(job->path, "r");
+    if(ff == NULL)
+        FAIL("Failed to open");
+    setvbuf(ff, NULL, _IOFBF, 1<<20);
+    newline = 1;
+    while(1){
+        if(fgets(line, REPROC_LINE, ff) == NULL)
+            FAIL("No ## line before the data");
+        if(newline && line[0] == '#' && line[1] == '#')
+            break;
+        newline = strchr(line, '\n') != NULL;
+    }
+    if(fgets(line, REPROC_LINE, ff) == NULL)
+        FAIL("No timestamp");
+
+    // Build the output file name from the input name
+    base = strrchr(job->path, '/');
+    base = base ? base+1 : job->path;
+    if(opt.outdir[0])
+        snprintf(outpath, sizeof(outpath), "%s/%s", opt.outdir, base);
+    else
+        strcpy(outpath, job->path);
+    end = strrchr(outpath, '.');
+    if(end && end > strrchr(outpath, '/'))
+        *end = '\0';
+    strncat(outpath, PROC_EXT, sizeof(outpath) - strlen(outpath) - 1);
+    fo = fopen(outpath, "w");
+    if(fo == NULL)
+        FAIL("Failed to open %s", outpath);
+    setvbuf(fo, NULL, _IOFBF, 1<<20);
+
+    // Name the columns: the calibrated channels followed by the derived
+    // channels
+    job->ncol = naich + NDERIVED;
+    for(ii=0; ii<naich; ii++){
+        if(dconf[0].aich[ii].label[0])
+            strcpy(job->stat[ii].name, dconf[0].aich[ii].label);
+        else
+            sprintf(job->stat[ii].name, "aich%u", ii);
+    }
+    for(ii=0; ii<NDERIVED; ii++)
+        strcpy(job->stat[naich+ii].name, derived_names[ii]);
+    for(ii=0; ii<job->ncol; ii++){
+        lstat_name(names[ii], job->stat[ii].name);
+        lstat_init(&sketch[ii]);
+    }
+    fprintf(fo, "# %s", line);
+    fputc('#', fo);
+    for(ii=0; ii<job->ncol; ii++)
+        fprintf(fo, " %s", job->stat[ii].name);
+    fputc('\n', fo);
+
+    // Stream the samples, averaging navg at a time.  The last block may be
+    // short; it is averaged over the samples it has.
+    count = 0;
+    index = 0;
+    memset(sum, 0, sizeof(sum));
+    last = 0;
+    while(!last){
+        last = fgets(line, REPROC_LINE, ff) == NULL;
+        start = line;
+        for(ii=0; ii<naich && !last; ii++){
+            v[ii] = rawbits ?
+                    rawscale[ii] * strtol(start, &end, 10) + rawoffset[ii] :
+                    strtod(start, &end);
+            // Stop at a truncated row
+            if(end == start)
+                last = 1;
+            start = end;
+        }
+        if(!last){
+            for(ii=0; ii<naich; ii++)
+                sum[ii] += v[ii];
+            index++;
+            if(++count < navg)
+                continue;
+        }else if(count == 0)
+            break;
+
+        for(ii=0; ii<naich; ii++){
+            v[ii] = sum[ii] / count;
+            sum[ii] = 0.;
+            // Calibrated channel
+            row[ii] = dconf[0].aich[ii].calslope *
+                    (v[ii] - dconf[0].aich[ii].calzero);
+        }
+        // The row is stamped at the center of its block
+        row[naich + D_TIME] = dt * (index - 0.5*(count + 1));
+        count = 0;
+        for(ii=0; ii<4; ii++)
+            row[naich + D_PLATE_THIGH + ii] = ltc_k_t(v[opt.tc[ii]], tcj_C);
+        row[naich + D_O2_SCFH] = opt.o2 < 0 ? NAN :
+                LGAS_O2_SLOPE_SCFH * v[opt.o2] + o2_offset;
+        row[naich + D_FG_SCFH] = opt.fg < 0 ? NAN :
+                LGAS_FG_SLOPE_SCFH * v[opt.fg] + fg_offset;
+        row[naich + D_O2_GPS] = convert_to_mass(row[naich + D_O2_SCFH], LGAS_O2_MW);
+        row[naich + D_FG_GPS] = convert_to_mass(row[naich + D_FG_SCFH], LGAS_FG_MW);
+        lheat_plate(row[naich + D_PLATE_THIGH], row[naich + D_PLATE_TLOW],
+                row[naich + D_COOL_TLOW], row[naich + D_COOL_THIGH],
+                &row[naich + D_PLATE_Q], &row[naich + D_PLATE_TPEAK]);
+        if(lheat_coolant(air_gps, water_gps, row[naich + D_COOL_TLOW],
+                row[naich + D_COOL_THIGH], &row[naich + D_COOL_Q]))
+            row[naich + D_COOL_Q] = NAN;
+
+        for(jj=0; jj<job->ncol; jj++){
+            lstat_add(&sketch[jj], row[jj]);
+            fprintf(fo, "%.6e\t", row[jj]);
+        }
+        fputc('\n', fo);
+    }
+    job->samples = index;
+
+    // Keep the results, save the sketches, and add them to the campaign
+    for(ii=0; ii<job->ncol; ii++)
+        stat_reduce(&job->stat[ii], &sketch[ii]);
+    end = strrchr(outpath, '.');
+    strcpy(end, STAT_EXT);
+    if(write_stat_file(outpath, job->samples,
+            (const char (*)[LSTAT_MAX_STR])names, sketch, job->ncol))
+        FAIL("Failed to write %s", outpath);
+    strcpy(end, PROC_EXT);
+    pthread_mutex_lock(&total.lock);
+    total.samples += job->samples;
+    pthread_mutex_unlock(&total.lock);
+    for(ii=0; ii<job->ncol; ii++)
+        if(merge_total(names[ii], &sketch[ii]))
+            FAIL("Too many distinct column names in the campaign");
+
+done:
+    if(ff)
+        fclose(ff);
+    if(fo && fclose(fo) && !job->err){
+        job->err = 1;
+        snprintf(job->message, REPROC_MAX_MSG, "Failed to write %s", outpath);
+    }
+#undef FAIL
+}
+
+
+//******************************************************************************
+int merge_total(const char* name, const LSTAT* sketch){
+    unsigned int ii;
+    int err = 0;
+
+    pthread_mutex_lock(&total.lock);
+    for(ii=0; ii<total.n && strcmp(total.name[ii], name); ii++);
+    if(ii == total.n && total.n < NTOTAL_MAX){
+        strcpy(total.name[ii], name);
+        lstat_init(&total.stat[total.n++]);
+    }
+    if(ii < total.n)
+        lstat_merge(&total.stat[ii], sketch);
+    else
+        err = 1;
+    pthread_mutex_unlock(&total.lock);
+    return err;
+}
+
+
+//******************************************************************************
+int write_stat_file(const char* path, const unsigned long samples,
+                const char names[][LSTAT_MAX_STR], const LSTAT* sketch,
+                const unsigned int n){
+    unsigned int ii;
+    FILE* ff;
+    int err = 0;
+
+    ff = fopen(path, "w");
+    if(ff == NULL)
+        return 1;
+    fprintf(ff, "# samples %lu\n", samples);
+    for(ii=0; ii<n && !err; ii++)
+        err = lstat_write(ff, names[ii], &sketch[ii]);
+    return fclose(ff) || err;
+}
+
+
+//******************************************************************************
+int read_stat_file(const char* path){
+    // One sketch line can hold LSTAT_CAP numbers
+    static char line[LSTAT_CAP * 26 + 1024];
+    static LSTAT sketch;
+    char name[LSTAT_MAX_STR];
+    unsigned long samples;
+    FILE* ff;
+
+    ff = fopen(path, "r");
+    if(ff == NULL){
+        fprintf(stderr, "REPROC: Failed to open %s\n", path);
+        return 1;
+    }
+    while(fgets(line, sizeof(line), ff)){
+        if(sscanf(line, "# samples %lu", &samples) == 1)
+            total.samples += samples;
+        else if(!lstat_read(line, name, &sketch) && merge_total(name, &sketch)){
+            fprintf(stderr, "REPROC: Too many distinct column names in %s\n",
+                    path);
+            fclose(ff);
+            return 1;
+        }
+    }
+    fclose(ff);
+    return 0;
+}
+
+
+//******************************************************************************
+static void write_row(FILE* ff, const char* file, const unsigned long samples,
+                const STAT* s){
+    fprintf(ff, "%s\t%lu\t%s\t%llu\t%.6e\t%.6e\t%.6e\t%.6e\t%.6e\t%.6e\t%.6e\n",
+            file, samples, s->name, s->n, s->mean, s->std, s->min, s->max,
+            s->p[0], s->p[1], s->p[2]);
+}
+
+//******************************************************************************
+void write_summary(FILE* ff){
+    unsigned int ii, jj;
+    STAT s;
+
+    fprintf(ff, "file\tsamples\tcolumn\tn\tmean\tstd\tmin\tmax\tp1\tp50\tp99\n");
+    for(ii=0; ii<njobs; ii++){
+        if(jobs[ii].err)
+            continue;
+        for(jj=0; jj<jobs[ii].ncol; jj++)
+            write_row(ff, jobs[ii].path, jobs[ii].samples, &jobs[ii].stat[jj]);
+    }
+    // The campaign, merged from every file
+    for(ii=0; ii<total.n; ii++){
+        strcpy(s.name, total.name[ii]);
+        stat_reduce(&s, &total.stat[ii]);
+        write_row(ff, "ALL", total.samples, &s);
+    }
+}